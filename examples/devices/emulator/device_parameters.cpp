@@ -20,23 +20,60 @@ namespace devices {
 
 using namespace teeui;
 
+namespace {
+
+constexpr double kMM2px = 6.45211;
+constexpr double kDP2px = 400.0 / 412.0;
+
+constexpr double mm(double v) {
+    return v * kMM2px;
+}
+constexpr double dp(double v) {
+    return v * kDP2px;
+}
+
+constexpr DisplayProfile kRegular[] = {{
+        kMM2px,
+        kDP2px,
+        400,        /* rightEdgeOfScreen */
+        800,        /* bottomOfScreen */
+        mm(20.26),  /* powerButtonTop */
+        mm(30.26),  /* powerButtonBottom */
+        mm(40.26),  /* volUpButtonTop */
+        mm(50.26),  /* volUpButtonBottom */
+        dp(14),     /* defaultFontSize */
+        dp(16),     /* bodyFontSize */
+}};
+
+constexpr DisplayProfile kMagnified[] = {{
+        kMM2px,
+        kDP2px,
+        400,        /* rightEdgeOfScreen */
+        800,        /* bottomOfScreen */
+        mm(20.26),  /* powerButtonTop */
+        mm(30.26),  /* powerButtonBottom */
+        mm(40.26),  /* volUpButtonTop */
+        mm(50.26),  /* volUpButtonBottom */
+        dp(18),     /* defaultFontSize */
+        dp(20),     /* bodyFontSize */
+}};
+
+static_assert(sizeof(kRegular) == sizeof(kMagnified),
+              "Both font profiles must cover all displays");
+
+}  // namespace
+
 std::vector<context<ConUIParameters>> getDeviceContext(bool magnified) {
-    context<ConUIParameters> ctx(6.45211, 400.0 / 412.0);
-    ctx.setParam<RightEdgeOfScreen>(400_px);
-    ctx.setParam<BottomOfScreen>(800_px);
-    ctx.setParam<PowerButtonTop>(20.26_mm);
-    ctx.setParam<PowerButtonBottom>(30.26_mm);
-    ctx.setParam<VolUpButtonTop>(40.26_mm);
-    ctx.setParam<VolUpButtonBottom>(50.26_mm);
-
-    if (magnified) {
-        ctx.setParam<DefaultFontSize>(18_dp);
-        ctx.setParam<BodyFontSize>(20_dp);
-    } else {
-        ctx.setParam<DefaultFontSize>(14_dp);
-        ctx.setParam<BodyFontSize>(16_dp);
+    const auto& profiles = magnified ? kMagnified : kRegular;
+    std::vector<context<ConUIParameters>> result;
+    for (const auto& profile : profiles) {
+        result.push_back(profile.toContext());
     }
-    return {ctx};
+    return result;
+}
+
+StaticDisplayProfiles getStaticDisplayProfiles() {
+    return {kRegular, kMagnified, sizeof(kRegular) / sizeof(kRegular[0])};
 }
 
 }  // namespace devices
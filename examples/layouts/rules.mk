@@ -24,6 +24,33 @@ MODULE_SRCS += \
 
 MODULE_EXPORT_INCLUDES += $(LOCAL_DIR)/include
 
+# Codepoint coverage of the fonts, which the prompt preflight checks prompts
+# against before anything is drawn. See layouts/prompt_coverage.h.
+FONT_COVERAGE_TOOL := $(LOCAL_DIR)/../../tools/font_coverage.py
+FONT_COVERAGE_FONTS := \
+	$(LOCAL_DIR)/Roboto-Medium.ttf \
+	$(LOCAL_DIR)/Roboto-Regular.ttf \
+	$(LOCAL_DIR)/Shield.ttf \
+
+FONT_COVERAGE_INCLUDE := $(call TOBUILDDIR,$(LOCAL_DIR)/include)
+FONT_COVERAGE_HEADER := $(FONT_COVERAGE_INCLUDE)/layouts/font_coverage.h
+
+$(FONT_COVERAGE_HEADER): FONT_COVERAGE_TOOL := $(FONT_COVERAGE_TOOL)
+$(FONT_COVERAGE_HEADER): FONT_COVERAGE_FONTS := $(FONT_COVERAGE_FONTS)
+$(FONT_COVERAGE_HEADER): $(FONT_COVERAGE_TOOL) $(FONT_COVERAGE_FONTS)
+	@$(MKDIR)
+	@echo generating $@
+	$(NOECHO)$(FONT_COVERAGE_TOOL) --output $@ $(FONT_COVERAGE_FONTS)
+
+GENERATED += $(FONT_COVERAGE_HEADER)
+MODULE_EXPORT_INCLUDES += $(FONT_COVERAGE_INCLUDE)
+MODULE_EXPORT_SRCDEPS += $(FONT_COVERAGE_HEADER)
+
+FONT_COVERAGE_TOOL :=
+FONT_COVERAGE_FONTS :=
+FONT_COVERAGE_INCLUDE :=
+FONT_COVERAGE_HEADER :=
+
 MODULE_INCLUDES += \
 	$(LIBTEEUI_ROOT)/include \
 	$(LOCAL_DIR)/include \
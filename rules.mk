@@ -23,12 +23,115 @@ CONFIRMATIONUI_LAYOUTS ?= $(LOCAL_DIR)/examples/layouts
 CONFIRMATIONUI_DEVICE_PARAMS ?= $(LOCAL_DIR)/examples/devices/emulator
 
 MODULE_SRCS += \
+	$(LOCAL_DIR)/src/band_bins.cpp \
+	$(LOCAL_DIR)/src/button_shapes.cpp \
+	$(LOCAL_DIR)/src/hmac_key_schedule.cpp \
 	$(LOCAL_DIR)/src/main.cpp \
+	$(LOCAL_DIR)/src/memory_stats.cpp \
+	$(LOCAL_DIR)/src/nonce_pool.cpp \
+	$(LOCAL_DIR)/src/offscreen_frame.cpp \
+	$(LOCAL_DIR)/src/palette_frame.cpp \
+	$(LOCAL_DIR)/src/prompt_preflight.cpp \
+	$(LOCAL_DIR)/src/render_sweep.cpp \
+	$(LOCAL_DIR)/src/request_recorder.cpp \
+	$(LOCAL_DIR)/src/scanline_rasterizer.cpp \
 	$(LOCAL_DIR)/src/secure_input_tracker.cpp \
+	$(LOCAL_DIR)/src/self_test.cpp \
+	$(LOCAL_DIR)/src/session_telemetry.cpp \
+	$(LOCAL_DIR)/src/session_timers.cpp \
+	$(LOCAL_DIR)/src/sprite_cache.cpp \
+	$(LOCAL_DIR)/src/stripe_renderer.cpp \
+	$(LOCAL_DIR)/src/tiled_renderer.cpp \
 	$(LOCAL_DIR)/src/trusty_operation.cpp \
 	$(LOCAL_DIR)/src/trusty_confirmation_ui.cpp \
 	$(LOCAL_DIR)/src/trusty_time_stamper.cpp \
 
+# Pre-warm the UI when the channel is initialized. This needs enough heap for
+# one RGBA8 frame per display on top of the default budget.
+CONFIRMATIONUI_PREWARM ?= false
+ifeq (true,$(call TOBOOL,$(CONFIRMATIONUI_PREWARM)))
+MODULE_COMPILEFLAGS += -DCONFIRMATIONUI_PREWARM=1
+endif
+
+# Render full frames in cache sized bands. See tiled_renderer.h.
+CONFIRMATIONUI_TILED_RENDERING ?= false
+ifeq (true,$(call TOBOOL,$(CONFIRMATIONUI_TILED_RENDERING)))
+MODULE_COMPILEFLAGS += -DCONFIRMATIONUI_TILED_RENDERING=1
+endif
+
+# Draw the button icons with the scanline rasterizer. See scanline_rasterizer.h.
+CONFIRMATIONUI_SCANLINE_SHAPES ?= false
+ifeq (true,$(call TOBOOL,$(CONFIRMATIONUI_SCANLINE_SHAPES)))
+MODULE_COMPILEFLAGS += -DCONFIRMATIONUI_SCANLINE_SHAPES=1
+endif
+
+# Render into palette indexed frames. See palette_frame.h.
+CONFIRMATIONUI_PALETTE_FRAME ?= false
+ifeq (true,$(call TOBOOL,$(CONFIRMATIONUI_PALETTE_FRAME)))
+MODULE_COMPILEFLAGS += -DCONFIRMATIONUI_PALETTE_FRAME=1
+endif
+
+# Record the requests of all sessions for replay. Debug builds only, the
+# recording includes prompt content. See tools/replay.
+CONFIRMATIONUI_RECORDER ?= false
+ifeq (true,$(call TOBOOL,$(CONFIRMATIONUI_RECORDER)))
+MODULE_COMPILEFLAGS += -DCONFIRMATIONUI_RECORDER=1
+endif
+
+# Serve the render sweep through the telemetry protocol. See render_sweep.h.
+CONFIRMATIONUI_RENDER_SWEEP ?= false
+ifeq (true,$(call TOBOOL,$(CONFIRMATIONUI_RENDER_SWEEP)))
+MODULE_COMPILEFLAGS += -DCONFIRMATIONUI_RENDER_SWEEP=1
+endif
+
+# Account heap and stack usage per phase and command. See memory_stats.h.
+CONFIRMATIONUI_MEMORY_STATS ?= false
+ifeq (true,$(call TOBOOL,$(CONFIRMATIONUI_MEMORY_STATS)))
+MODULE_COMPILEFLAGS += -DCONFIRMATIONUI_MEMORY_STATS=1
+endif
+
+# Serve the performance self-test through the telemetry protocol and the test
+# commands. See self_test.h.
+CONFIRMATIONUI_SELF_TEST ?= false
+ifeq (true,$(call TOBOOL,$(CONFIRMATIONUI_SELF_TEST)))
+MODULE_COMPILEFLAGS += -DCONFIRMATIONUI_SELF_TEST=1
+endif
+
+# Initialize the layouts and fetch the auth token key at startup instead of
+# for the first session.
+CONFIRMATIONUI_EAGER_INIT ?= false
+ifeq (true,$(call TOBOOL,$(CONFIRMATIONUI_EAGER_INIT)))
+MODULE_COMPILEFLAGS += -DCONFIRMATIONUI_EAGER_INIT=1
+endif
+
+# Present the chrome before the prompt body is rendered. This needs enough
+# heap for one RGBA8 frame per display on top of the default budget.
+CONFIRMATIONUI_PROGRESSIVE_FRAME ?= false
+ifeq (true,$(call TOBOOL,$(CONFIRMATIONUI_PROGRESSIVE_FRAME)))
+MODULE_COMPILEFLAGS += -DCONFIRMATIONUI_PROGRESSIVE_FRAME=1
+endif
+
+# Compose frames in cacheable offscreen frames that are kept across sessions
+# and copied to the framebuffer, instead of blending in the framebuffer. This
+# needs enough heap for one RGBA8 frame per display on top of the default
+# budget.
+CONFIRMATIONUI_OFFSCREEN_COMPOSITION ?= false
+ifeq (true,$(call TOBOOL,$(CONFIRMATIONUI_OFFSCREEN_COMPOSITION)))
+MODULE_COMPILEFLAGS += -DCONFIRMATIONUI_OFFSCREEN_COMPOSITION=1
+endif
+
+# Render frames in this many stripes on as many threads. Trusty apps are
+# single threaded, so leave it at 1 unless the platform provides std::thread.
+# See stripe_renderer.h.
+CONFIRMATIONUI_RENDER_THREADS ?= 1
+MODULE_COMPILEFLAGS += -DCONFIRMATIONUI_RENDER_THREADS=$(CONFIRMATIONUI_RENDER_THREADS)
+
+# Time budget for rendering a frame in microseconds. Renders that are
+# projected to miss it drop anti-aliasing and blending. 0 disables the budget.
+# See render_budget.h.
+CONFIRMATIONUI_RENDER_BUDGET_US ?= 0
+MODULE_COMPILEFLAGS += -DCONFIRMATIONUI_RENDER_BUDGET_US=$(CONFIRMATIONUI_RENDER_BUDGET_US)
+
 MODULE_LIBRARY_DEPS += \
 	trusty/user/base/lib/keymaster \
 	trusty/user/base/lib/libc-trusty \
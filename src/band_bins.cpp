@@ -0,0 +1,83 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "band_bins.h"
+
+#include <new>
+
+using teeui::Color;
+using teeui::Error;
+
+bool BandBins::reset(uint32_t rows, uint32_t bands) {
+    /* Keep the buffers for the next render. */
+    if (!runs_) {
+        runs_.reset(new (std::nothrow) Run[CONFIRMATIONUI_BAND_BIN_RUNS]);
+    }
+    if (bands > band_capacity_) {
+        heads_.reset(new (std::nothrow) Chain[bands]);
+        band_capacity_ = heads_ ? bands : 0;
+    }
+    if (!runs_ || !heads_) {
+        release();
+        return false;
+    }
+    for (uint32_t band = 0; band < bands; ++band) {
+        heads_[band] = {kNone, kNone};
+    }
+    bands_ = bands;
+    rows_ = rows ? rows : 1;
+    count_ = 0;
+    return true;
+}
+
+void BandBins::release() {
+    runs_.reset();
+    heads_.reset();
+    band_capacity_ = 0;
+    bands_ = 0;
+    count_ = 0;
+}
+
+Error BandBins::append(uint32_t element, uint32_t x, uint32_t y, Color color) {
+    uint32_t band = y / rows_;
+    if (band >= bands_) {
+        return Error::OutOfBoundsDrawing;
+    }
+    if (x > UINT16_MAX || y > UINT16_MAX || element > UINT8_MAX) {
+        return Error::OutOfMemory;
+    }
+    auto& chain = heads_[band];
+    if (chain.last != kNone) {
+        auto& last = runs_[chain.last];
+        if (last.y == y && last.color == color && last.element == element &&
+            uint32_t(last.x) + last.length == x && last.length < UINT16_MAX) {
+            ++last.length;
+            return Error::OK;
+        }
+    }
+    if (count_ >= CONFIRMATIONUI_BAND_BIN_RUNS) {
+        return Error::OutOfMemory;
+    }
+    runs_[count_] = {uint16_t(x), uint16_t(y), 1, uint8_t(element), color,
+                     kNone};
+    if (chain.last != kNone) {
+        runs_[chain.last].next = count_;
+    } else {
+        chain.first = count_;
+    }
+    chain.last = count_++;
+    return Error::OK;
+}
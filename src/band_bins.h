@@ -0,0 +1,123 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+#include <teeui/error.h>
+#include <teeui/utils.h>
+
+/*
+ * Largest number of runs BandBins holds at once. Each run takes 16 bytes, and
+ * the buffer for all of them is allocated up front, 128 KiB by default, well
+ * within min_heap in manifest.json. Renders that need more fail with
+ * OutOfMemory and are drawn directly.
+ */
+#ifndef CONFIRMATIONUI_BAND_BIN_RUNS
+#define CONFIRMATIONUI_BAND_BIN_RUNS (8 * 1024)
+#endif
+
+/*
+ * BandBins sorts the pixels drawn by layout elements into horizontal bands of
+ * a fixed number of rows, so that an element spanning several bands is drawn
+ * once and every band later replays only its own pixels. As in Sprite,
+ * consecutive pixels of one row with the same color form one run. Runs keep
+ * the order in which they were drawn and the index of the element that drew
+ * them. All runs live in one fixed buffer, and the runs of each band are
+ * chained in drawing order.
+ */
+class BandBins {
+public:
+    /*
+     * Empties the bins and splits the rows into bands of rows each. Returns
+     * false if the buffers cannot be allocated.
+     */
+    bool reset(uint32_t rows, uint32_t bands);
+    void release();
+
+    /*
+     * Appends a pixel drawn by the given element to the bin of its band.
+     * Returns OutOfBoundsDrawing if the pixel is below the last band, and
+     * OutOfMemory once CONFIRMATIONUI_BAND_BIN_RUNS runs are held.
+     */
+    teeui::Error append(uint32_t element,
+                        uint32_t x,
+                        uint32_t y,
+                        teeui::Color color);
+
+    /*
+     * Replays the runs of the given band in band coordinates, in the order
+     * they were drawn, with drawPixel(x, y, color).
+     */
+    template <typename Drawer>
+    teeui::Error replay(uint32_t band, const Drawer& drawPixel) const {
+        return replay(band, kAllElements, drawPixel);
+    }
+
+    /* Same as above but only replays the runs of the given element. */
+    template <typename Drawer>
+    teeui::Error replay(uint32_t band,
+                        uint32_t element,
+                        const Drawer& drawPixel) const {
+        if (band >= bands_) {
+            return teeui::Error::OK;
+        }
+        uint32_t top = band * rows_;
+        for (uint32_t i = heads_[band].first; i != kNone; i = runs_[i].next) {
+            const auto& run = runs_[i];
+            if (element != kAllElements && run.element != element) {
+                continue;
+            }
+            for (uint32_t x = run.x; x < uint32_t(run.x) + run.length; ++x) {
+                if (auto error = drawPixel(x, run.y - top, run.color)) {
+                    return error;
+                }
+            }
+        }
+        return teeui::Error::OK;
+    }
+
+private:
+    static constexpr const uint32_t kAllElements = UINT32_MAX;
+    static constexpr const uint32_t kNone = UINT32_MAX;
+
+    struct Run {
+        uint16_t x;
+        uint16_t y;
+        uint16_t length;
+        uint8_t element;
+        teeui::Color color;
+        /* Index of the next run of the same band, or kNone. */
+        uint32_t next;
+    };
+
+    /* Indices of the first and last run of a band, or kNone. */
+    struct Chain {
+        uint32_t first;
+        uint32_t last;
+    };
+
+    std::unique_ptr<Run[]> runs_;
+    std::unique_ptr<Chain[]> heads_;
+    uint32_t band_capacity_ = 0;
+    uint32_t bands_ = 0;
+    uint32_t rows_ = 1;
+    uint32_t count_ = 0;
+};
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "button_shapes.h"
+
+using teeui::Error;
+
+Error ButtonShape::draw(const teeui::PixelDrawer& drawPixel) const {
+    if (auto error = scanline::fillRoundedRect(body, color, clip, drawPixel)) {
+        return error;
+    }
+    for (auto& object : objects) {
+        if (auto error = scanline::fillConvex(object.data(),
+                                              object.data() + object.size(),
+                                              object_color, clip, drawPixel)) {
+            return error;
+        }
+    }
+    return Error::OK;
+}
+
+void ButtonShape::centerObjects() {
+    double left = INFINITY, top = INFINITY;
+    double right = -INFINITY, bottom = -INFINITY;
+    for (auto& object : objects) {
+        for (auto& p : object) {
+            left = fmin(left, p.x);
+            right = fmax(right, p.x);
+            top = fmin(top, p.y);
+            bottom = fmax(bottom, p.y);
+        }
+    }
+    if (!(left <= right)) {
+        return;
+    }
+    double dx = (body.left + body.right - left - right) / 2;
+    double dy = (body.top + body.bottom - top - bottom) / 2;
+    for (auto& object : objects) {
+        for (auto& p : object) {
+            p.x += dx;
+            p.y += dy;
+        }
+    }
+}
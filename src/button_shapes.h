@@ -0,0 +1,123 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+
+#include <tuple>
+#include <vector>
+
+#include <teeui/error.h>
+#include <teeui/utils.h>
+
+#include "element_index.h"
+#include "scanline_rasterizer.h"
+
+/*
+ * ButtonShape is the geometry of a teeui::Button element resolved to pixels,
+ * drawn with the scanline rasterizer: the rounded body in the button color,
+ * then the convex objects, centered on the body, in the object color.
+ */
+struct ButtonShape {
+    scanline::RoundedRect body;
+    scanline::Clip clip;
+    teeui::Color color;
+    teeui::Color object_color;
+    std::vector<std::vector<scanline::Point>> objects;
+
+    teeui::Error draw(const teeui::PixelDrawer& drawPixel) const;
+
+    /* Evaluates the button parameters of Element in the given context. */
+    template <typename Element, typename Context>
+    static ButtonShape of(const Context& ctx) {
+        ButtonShape shape;
+        double x = (ctx = Element::pos_x).count();
+        double y = (ctx = Element::pos_y).count();
+        double w = (ctx = Element::dim_w).count();
+        double h = (ctx = Element::dim_h).count();
+        shape.body = {x,
+                      y,
+                      x + w,
+                      y + h,
+                      (ctx = Element::button_radius).count(),
+                      Element::button_round_top_left,
+                      Element::button_round_top_right,
+                      Element::button_round_bottom_left,
+                      Element::button_round_bottom_right};
+        /* Same clipping as teeui::LayoutElement. */
+        shape.clip = {int64_t(x), int64_t(y), int64_t(x) + int64_t(w),
+                      int64_t(y) + int64_t(h)};
+        shape.color = ctx = Element::button_color;
+        shape.object_color = ctx = Element::button_drawable_object_color;
+
+        std::apply(
+                [&](const auto&... objects) {
+                    (shape.addObject(objects.begin(), objects.end()), ...);
+                },
+                ctx = Element::button_drawable_objects);
+        shape.centerObjects();
+        return shape;
+    }
+
+private:
+    template <typename Iter>
+    void addObject(Iter begin, Iter end) {
+        std::vector<scanline::Point> points;
+        for (auto p = begin; p != end; ++p) {
+            points.push_back({p->x().count(), p->y().count()});
+        }
+        objects.push_back(std::move(points));
+    }
+
+    void centerObjects();
+};
+
+/*
+ * ButtonShapes holds the resolved shapes of the given button elements of one
+ * layout. Elements not in the list are drawn by teeui.
+ */
+template <typename... Elements>
+class ButtonShapes {
+public:
+    template <typename Context>
+    static ButtonShapes of(const Context& ctx) {
+        ButtonShapes result;
+        result.shapes_ = {ButtonShape::of<Elements>(ctx)...};
+        return result;
+    }
+
+    /* True if Element is one of the button elements. */
+    template <typename Element>
+    static constexpr bool holds() {
+        return elementIndex<Element, Elements...>() < sizeof...(Elements);
+    }
+
+    template <typename Element>
+    teeui::Error draw(Element& element,
+                      const teeui::PixelDrawer& drawPixel) const {
+        constexpr size_t index = elementIndex<Element, Elements...>();
+        if constexpr (index == sizeof...(Elements)) {
+            return element.draw(drawPixel);
+        } else {
+            return shapes_[index].draw(drawPixel);
+        }
+    }
+
+private:
+    std::vector<ButtonShape> shapes_;
+};
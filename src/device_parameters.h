@@ -17,6 +17,7 @@
 #pragma once
 
 #include <layouts/layout.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <vector>
 
@@ -25,4 +26,53 @@ namespace devices {
 std::vector<teeui::context<teeui::ConUIParameters>> getDeviceContext(
         bool magnified);
 
+/*
+ * DisplayProfile holds the panel parameters of one display with all lengths
+ * already resolved to pixels. Devices whose parameters are known at build time
+ * can provide them as constexpr tables. The UI then instantiates the layout
+ * for each profile once and reuses it for every prompt.
+ */
+struct DisplayProfile {
+    double mm2px;
+    double dp2px;
+    double rightEdgeOfScreen;
+    double bottomOfScreen;
+    double powerButtonTop;
+    double powerButtonBottom;
+    double volUpButtonTop;
+    double volUpButtonBottom;
+    double defaultFontSize;
+    double bodyFontSize;
+
+    teeui::context<teeui::ConUIParameters> toContext() const {
+        using namespace teeui;
+        context<ConUIParameters> ctx(mm2px, dp2px);
+        ctx.setParam<RightEdgeOfScreen>(pxs(rightEdgeOfScreen));
+        ctx.setParam<BottomOfScreen>(pxs(bottomOfScreen));
+        ctx.setParam<PowerButtonTop>(pxs(powerButtonTop));
+        ctx.setParam<PowerButtonBottom>(pxs(powerButtonBottom));
+        ctx.setParam<VolUpButtonTop>(pxs(volUpButtonTop));
+        ctx.setParam<VolUpButtonBottom>(pxs(volUpButtonBottom));
+        ctx.setParam<DefaultFontSize>(pxs(defaultFontSize));
+        ctx.setParam<BodyFontSize>(pxs(bodyFontSize));
+        return ctx;
+    }
+};
+
+/*
+ * Static profiles of all displays for the regular and the magnified font
+ * profile. count is 0 for devices that compute their context at runtime.
+ */
+struct StaticDisplayProfiles {
+    const DisplayProfile* regular;
+    const DisplayProfile* magnified;
+    size_t count;
+};
+
+/*
+ * Optional. The default implementation returns no profiles, in which case the
+ * UI falls back to getDeviceContext() for every prompt.
+ */
+StaticDisplayProfiles getStaticDisplayProfiles();
+
 }  // namespace devices
@@ -0,0 +1,37 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include <type_traits>
+
+/*
+ * Returns the position of Element in Elements, or sizeof...(Elements) if it
+ * is not in the list.
+ */
+template <typename Element, typename... Elements>
+constexpr size_t elementIndex() {
+    constexpr bool matches[] = {std::is_same<Element, Elements>::value...,
+                                false};
+    for (size_t i = 0; i < sizeof...(Elements); ++i) {
+        if (matches[i]) {
+            return i;
+        }
+    }
+    return sizeof...(Elements);
+}
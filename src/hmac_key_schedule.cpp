@@ -0,0 +1,137 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hmac_key_schedule.h"
+
+#include <secure_input/secure_input_proto.h>
+#include "secure_input_batch_proto.h"
+
+#include <openssl/sha.h>
+
+#include <trusty_log.h>
+
+#define TLOG_TAG "confirmationui"
+
+using teeui::AuthTokenKey;
+using teeui::ByteBufferProxy;
+using teeui::Hmac;
+using teeui::optional;
+
+HmacKeySchedule::HmacKeySchedule() : prepared_(false) {
+    for (auto& state : states_) {
+        HMAC_CTX_init(&state);
+    }
+}
+
+HmacKeySchedule::~HmacKeySchedule() {
+    clear();
+}
+
+bool HmacKeySchedule::prepare(const AuthTokenKey& key) {
+    clear();
+    auto& base = states_[uint32_t(Label::None)];
+    if (!HMAC_Init_ex(&base, key.data(), key.size(), EVP_sha256(), nullptr)) {
+        TLOGE("Failed to prepare the HMAC key schedule\n");
+        clear();
+        return false;
+    }
+
+    const ByteBufferProxy labels[] = {
+            {},
+            secure_input::kConfirmationUIHandshakeLabel,
+            secure_input::kConfirmationUIEventLabel,
+            secure_input::kConfirmationUIEventBatchLabel,
+            /* Same as teeui::Operation::signConfirmation. */
+            "confirmation token",
+    };
+    static_assert(sizeof(labels) / sizeof(labels[0]) == uint32_t(Label::Count),
+                  "Every label needs a prepared state");
+    for (uint32_t i = uint32_t(Label::None) + 1; i < uint32_t(Label::Count);
+         ++i) {
+        if (!HMAC_CTX_copy_ex(&states_[i], &base) ||
+            !HMAC_Update(&states_[i], labels[i].data(), labels[i].size())) {
+            TLOGE("Failed to prepare the HMAC label state %u\n", i);
+            clear();
+            return false;
+        }
+    }
+    prepared_ = true;
+    return true;
+}
+
+void HmacKeySchedule::clear() {
+    /* HMAC_CTX_cleanup zeroizes the state. Leave it ready for reuse. */
+    for (auto& state : states_) {
+        HMAC_CTX_cleanup(&state);
+        HMAC_CTX_init(&state);
+    }
+    prepared_ = false;
+}
+
+optional<Hmac> HmacKeySchedule::mac(
+        Label label,
+        std::initializer_list<ByteBufferProxy> buffers) const {
+    PartialMac partial;
+    if (!partial.absorb(*this, label, buffers)) {
+        return {};
+    }
+    return partial.finish();
+}
+
+PartialMac::PartialMac() : ready_(false) {
+    HMAC_CTX_init(&state_);
+}
+
+PartialMac::~PartialMac() {
+    clear();
+}
+
+bool PartialMac::absorb(const HmacKeySchedule& keys,
+                        HmacKeySchedule::Label label,
+                        std::initializer_list<ByteBufferProxy> buffers) {
+    clear();
+    if (!keys.isPrepared() || label >= HmacKeySchedule::Label::Count) {
+        return false;
+    }
+    if (!HMAC_CTX_copy_ex(&state_, &keys.states_[uint32_t(label)])) {
+        clear();
+        return false;
+    }
+    for (auto& buffer : buffers) {
+        if (!HMAC_Update(&state_, buffer.data(), buffer.size())) {
+            clear();
+            return false;
+        }
+    }
+    ready_ = true;
+    return true;
+}
+
+optional<Hmac> PartialMac::finish() {
+    optional<Hmac> result;
+    Hmac hmac;
+    if (ready_ && HMAC_Final(&state_, hmac.data(), nullptr)) {
+        result = hmac;
+    }
+    clear();
+    return result;
+}
+
+void PartialMac::clear() {
+    HMAC_CTX_cleanup(&state_);
+    HMAC_CTX_init(&state_);
+    ready_ = false;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <initializer_list>
+
+#include <openssl/hmac.h>
+
+#include <teeui/common_message_types.h>
+#include <teeui/utils.h>
+
+/*
+ * HmacKeySchedule keeps HMAC-SHA256 states that have already absorbed the
+ * ipad/opad key blocks of an AuthTokenKey, and optionally one of the constant
+ * secure input or confirmation token labels. Each MAC clones the prepared
+ * state, so the key schedule and the label are hashed only once per key
+ * instead of once per MAC.
+ *
+ * The prepared states are key material. clear() zeroizes them.
+ */
+class HmacKeySchedule {
+public:
+    enum class Label : uint32_t {
+        None,
+        Handshake,
+        Event,
+        EventBatch,
+        ConfirmationToken,
+        // insert new labels above
+        Count,
+    };
+
+    HmacKeySchedule();
+    ~HmacKeySchedule();
+
+    /*
+     * Prepares the states for the given key. Returns false if BoringSSL failed
+     * in which case the schedule is left cleared.
+     */
+    bool prepare(const teeui::AuthTokenKey& key);
+    void clear();
+    bool isPrepared() const { return prepared_; }
+
+    /*
+     * Computes HMAC(key, label || buffers...) from the prepared state for the
+     * given label. Returns an empty optional if the schedule is not prepared or
+     * BoringSSL failed.
+     */
+    teeui::optional<teeui::Hmac> mac(
+            Label label,
+            std::initializer_list<teeui::ByteBufferProxy> buffers) const;
+
+    // HmacKeySchedule holds key material and is neither copyable nor movable.
+    HmacKeySchedule(const HmacKeySchedule&) = delete;
+    HmacKeySchedule& operator=(const HmacKeySchedule&) = delete;
+
+private:
+    friend class PartialMac;
+
+    HMAC_CTX states_[uint32_t(Label::Count)];
+    bool prepared_;
+};
+
+/*
+ * PartialMac is an HMAC-SHA256 state that has absorbed a label and a message
+ * ahead of time, so that only finish() remains when the MAC is needed. It is
+ * key material. clear() zeroizes it.
+ */
+class PartialMac {
+public:
+    PartialMac();
+    ~PartialMac();
+
+    /*
+     * Starts HMAC(key, label || buffers...) from the prepared state of keys.
+     * Returns false if keys is not prepared or BoringSSL failed, in which case
+     * the state is left cleared.
+     */
+    bool absorb(const HmacKeySchedule& keys,
+                HmacKeySchedule::Label label,
+                std::initializer_list<teeui::ByteBufferProxy> buffers);
+    /*
+     * Completes the MAC and clears the state. Returns an empty optional if
+     * nothing was absorbed or BoringSSL failed.
+     */
+    teeui::optional<teeui::Hmac> finish();
+    void clear();
+    bool isReady() const { return ready_; }
+
+    PartialMac(const PartialMac&) = delete;
+    PartialMac& operator=(const PartialMac&) = delete;
+
+private:
+    HMAC_CTX state_;
+    bool ready_;
+};
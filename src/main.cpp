@@ -28,18 +28,55 @@
 #include <memory>
 
 #include "ipc.h"
+#include "memory_stats.h"
+#include "request_recorder.h"
+#include "session_telemetry.h"
+#include "session_timers.h"
 #include "trusty_operation.h"
 
 struct chan_ctx {
     void* shm_base;
     size_t shm_len;
     std::unique_ptr<TrustyOperation> op;
+    uint32_t recorder_channel;
 };
 
+static SessionTimers session_timers;
+
 static inline bool is_inited(struct chan_ctx* ctx) {
     return ctx->shm_base;
 }
 
+static void update_timers(struct chan_ctx* ctx) {
+    bool ok = session_timers.arm(ctx, SessionTimers::Kind::Session,
+                                 ctx->op->sessionDeadline());
+    ok = session_timers.arm(ctx, SessionTimers::Kind::DoubleClick,
+                            ctx->op->doubleClickDeadline()) &&
+         ok;
+    if (!ok) {
+        TLOGE("Out of session timers\n");
+    }
+}
+
+static void on_deadline(void* _ctx,
+                        SessionTimers::Kind kind,
+                        monotonic_time_stamper::TimeStamp now) {
+    struct chan_ctx* ctx = (struct chan_ctx*)_ctx;
+
+    switch (kind) {
+    case SessionTimers::Kind::Session:
+        ctx->op->expireSession(now);
+        ctx->op->runDeferredWork();
+        break;
+    case SessionTimers::Kind::DoubleClick:
+        ctx->op->expireDoubleClick(now);
+        break;
+    default:
+        break;
+    }
+    update_timers(ctx);
+}
+
 static bool get_auth_token_key(teeui::AuthTokenKey& authKey) {
     long rc = keymaster_open();
 
@@ -65,6 +102,31 @@ static bool get_auth_token_key(teeui::AuthTokenKey& authKey) {
     return true;
 }
 
+/*
+ * The key is fetched for every channel and not kept beyond it. Only the first
+ * fetch is recorded in the startup profile.
+ */
+static bool fetch_auth_token_key(teeui::AuthTokenKey& authKey) {
+    auto begin = monotonic_time_stamper::nowPrecise();
+    if (!get_auth_token_key(authKey)) {
+        return false;
+    }
+    telemetry::recordStartup(CONFIRMATIONUI_STARTUP_KEY_FETCH, begin);
+    return true;
+}
+
+#if CONFIRMATIONUI_EAGER_INIT
+/*
+ * Does the work of the first session that does not depend on the client
+ * before the first connection is served.
+ */
+static void warm_up() {
+    auto begin = monotonic_time_stamper::nowPrecise();
+    TrustyConfirmationUI::warmUp();
+    telemetry::recordStartup(CONFIRMATIONUI_STARTUP_WARM_UP, begin);
+}
+#endif
+
 struct __attribute__((__packed__)) confirmationui_req {
     struct confirmationui_hdr hdr;
     union {
@@ -121,19 +183,23 @@ static int handle_init(handle_t chan,
                        struct chan_ctx* ctx) {
     int rc;
     struct confirmationui_hdr hdr;
+    telemetry::PhaseTimer timer(CONFIRMATIONUI_PHASE_INIT);
 
     if (is_inited(ctx)) {
+        timer.fail();
         TLOGE("TA is already initialized.\n");
         return ERR_BAD_STATE;
     }
 
     if (shm_len > CONFIRMATIONUI_MAX_MSG_SIZE) {
+        timer.fail();
         TLOGE("Shared memory too long\n");
         return ERR_BAD_LEN;
     }
 
     void* shm_base = mmap(0, shm_len, PROT_READ | PROT_WRITE, 0, shm_handle, 0);
     if (shm_base == MAP_FAILED) {
+        timer.fail();
         TLOGE("Failed to mmap() handle\n");
         return ERR_BAD_HANDLE;
     }
@@ -150,9 +216,17 @@ static int handle_init(handle_t chan,
 
     ctx->shm_base = shm_base;
     ctx->shm_len = shm_len;
+    recorder::recordInit(ctx->recorder_channel, timer.begin(), shm_len);
+
+    /*
+     * The client sends the prompt right after receiving the response. Use the
+     * time until it arrives to get the UI ready.
+     */
+    ctx->op->prewarm();
     return NO_ERROR;
 
 err:
+    timer.fail();
     munmap(shm_base, shm_len);
     return rc;
 }
@@ -163,6 +237,7 @@ static int handle_msg(handle_t chan, uint32_t req_len, struct chan_ctx* ctx) {
     uint32_t resp_len = sizeof(msg);
     struct confirmationui_hdr hdr;
     struct confirmationui_msg_args args;
+    auto arrival = monotonic_time_stamper::nowPrecise();
 
     if (!is_inited(ctx)) {
         TLOGE("TA is not initialized.\n");
@@ -178,10 +253,17 @@ static int handle_msg(handle_t chan, uint32_t req_len, struct chan_ctx* ctx) {
     memcpy(msg, ctx->shm_base, req_len);
 
     ctx->op->handleMsg(msg, req_len, ctx->shm_base, &resp_len);
+    /*
+     * Record after handling, so that the request that reads the recording
+     * does not end up in it.
+     */
+    recorder::recordMsg(ctx->recorder_channel, arrival, msg, req_len);
 
     hdr.cmd = CONFIRMATIONUI_CMD_MSG | CONFIRMATIONUI_RESP_BIT;
     args.msg_len = resp_len;
     rc = tipc_send2(chan, &hdr, sizeof(hdr), &args, sizeof(args));
+    /* The client has its response. Now do the slow part of teardown. */
+    ctx->op->runDeferredWork();
     if (rc != (int)(sizeof(hdr) + sizeof(args))) {
         TLOGE("Failed to send response (%d)\n", rc);
         if (rc >= 0) {
@@ -197,14 +279,17 @@ static int on_connect(const struct tipc_port* port,
                       handle_t chan,
                       const struct uuid* peer,
                       void** ctx_p) {
+    telemetry::PhaseTimer timer(CONFIRMATIONUI_PHASE_CONNECT);
     auto op = std::make_unique<TrustyOperation>();
     if (!op) {
+        timer.fail();
         TLOGE("Failed to allocate TrustyOperation\n");
         return ERR_NO_MEMORY;
     }
 
     struct chan_ctx* ctx = (struct chan_ctx*)calloc(1, sizeof(*ctx));
     if (!ctx) {
+        timer.fail();
         TLOGE("Failed to allocate channel context\n");
         return ERR_NO_MEMORY;
     }
@@ -216,10 +301,11 @@ static int on_connect(const struct tipc_port* port,
     op->setHmacKey(kTestKey);
 #else
     teeui::AuthTokenKey authKey;
-    if (get_auth_token_key(authKey) == true) {
+    if (fetch_auth_token_key(authKey) == true) {
         TLOGD("%s, get auth token key successfully\n", __func__);
     } else {
         TLOGE("%s, get auth token key failed\n", __func__);
+        timer.fail();
         /* Abort operation and free all resources. */
         op->abort();
         return ERR_GENERIC;
@@ -228,15 +314,20 @@ static int on_connect(const struct tipc_port* port,
 #endif
 
     ctx->op = std::move(op);
+    ctx->recorder_channel = recorder::newChannel();
     *ctx_p = ctx;
+    telemetry::markMilestone(CONFIRMATIONUI_MILESTONE_FIRST_CONNECT);
     return NO_ERROR;
 }
 
 static void on_channel_cleanup(void* _ctx) {
     struct chan_ctx* ctx = (struct chan_ctx*)_ctx;
+    session_timers.cancel(ctx);
+    recorder::recordClose(ctx->recorder_channel);
     /* Abort operation and free all resources. */
     munmap(ctx->shm_base, ctx->shm_len);
     ctx->op->abort();
+    ctx->op->runDeferredWork();
     ctx->op.reset();
     free(ctx);
 }
@@ -268,6 +359,7 @@ static int on_message(const struct tipc_port* port, handle_t chan, void* _ctx) {
 
     case CONFIRMATIONUI_CMD_MSG:
         rc = handle_msg(chan, req.msg_args.msg_len, ctx);
+        update_timers(ctx);
         goto out;
 
     default:
@@ -302,19 +394,46 @@ int main(void) {
     int rc;
     struct tipc_hset* hset;
 
+    telemetry::startMain();
+    memory::init();
     TLOGD("Initializing ConfirmationUI app\n");
 
+    auto begin = monotonic_time_stamper::nowPrecise();
     hset = tipc_hset_create();
     if (IS_ERR(hset)) {
         TLOGE("Failed to create handle set (%d)\n", PTR_ERR(hset));
         return PTR_ERR(hset);
     }
+    telemetry::recordStartup(CONFIRMATIONUI_STARTUP_HSET_CREATE, begin);
 
+    begin = monotonic_time_stamper::nowPrecise();
     rc = tipc_add_service(hset, &confirmationui_port, 1, 1,
                           &confirmationui_ops);
     if (rc != NO_ERROR) {
         return rc;
     }
+    telemetry::recordStartup(CONFIRMATIONUI_STARTUP_ADD_SERVICE, begin);
+    telemetry::markMilestone(CONFIRMATIONUI_MILESTONE_SERVICE_READY);
+
+#if CONFIRMATIONUI_EAGER_INIT
+    /* Connections that arrive in the meantime wait in the port queue. */
+    warm_up();
+#endif
 
-    return tipc_run_event_loop(hset);
+    /*
+     * Like tipc_run_event_loop, but wakes up when a session deadline expires,
+     * so that abandoned sessions release the secure display on schedule
+     * rather than when the client happens to send the next message.
+     */
+    do {
+        auto now = monotonic_time_stamper::now();
+        rc = tipc_handle_event(hset, session_timers.timeoutMillis(now));
+        if (rc == ERR_TIMED_OUT) {
+            rc = NO_ERROR;
+        }
+        session_timers.expire(monotonic_time_stamper::now(), on_deadline);
+    } while (rc == NO_ERROR);
+
+    TLOGE("Event loop terminated (%d)\n", rc);
+    return rc;
 }
@@ -0,0 +1,246 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "memory_stats.h"
+
+#if CONFIRMATIONUI_MEMORY_STATS
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <new>
+
+namespace memory {
+
+namespace {
+
+confirmationui_memory stats = {
+        .version = CONFIRMATIONUI_MEMORY_VERSION,
+        .stack_bytes = CONFIRMATIONUI_STACK_BYTES,
+        .phase_count = CONFIRMATIONUI_PHASE_COUNT,
+};
+
+/* Heap peak of the innermost scope. */
+uint32_t heap_peak;
+
+/*
+ * Every allocation is prefixed with its size. The header is padded to keep
+ * the alignment malloc() guarantees.
+ */
+constexpr size_t kHeaderBytes = alignof(max_align_t);
+
+void* allocate(size_t size) {
+    if (size > UINT32_MAX - kHeaderBytes) {
+        return nullptr;
+    }
+    auto p = static_cast<uint8_t*>(malloc(size + kHeaderBytes));
+    if (!p) {
+        return nullptr;
+    }
+    *reinterpret_cast<size_t*>(p) = size;
+    stats.heap_live += size;
+    ++stats.allocs;
+    stats.alloc_bytes += size;
+    heap_peak = std::max(heap_peak, stats.heap_live);
+    stats.heap_peak = std::max(stats.heap_peak, stats.heap_live);
+    return p + kHeaderBytes;
+}
+
+void deallocate(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    auto p = static_cast<uint8_t*>(ptr) - kHeaderBytes;
+    stats.heap_live -= *reinterpret_cast<size_t*>(p);
+    free(p);
+}
+
+constexpr uint32_t kStackPaint = 0xa5a5a5a5;
+/*
+ * Stack above the frame of init() that is taken by the startup code. It is
+ * subtracted from the stack size, so that painting stays within the stack.
+ */
+constexpr uintptr_t kStartupReserve = 4096;
+/* Stack right below the current frame that is never painted. */
+constexpr uintptr_t kRedZone = 256;
+
+uintptr_t stack_top;
+/* Deepest stack usage of the innermost scope before it was last painted. */
+uint32_t stack_peak;
+
+uintptr_t stackBottom() {
+    return stack_top - (CONFIRMATIONUI_STACK_BYTES - kStartupReserve);
+}
+
+/*
+ * Paints the unused stack from from up to the caller so that stackDepth() can
+ * find the deepest word that was written since.
+ */
+__attribute__((noinline)) void paintStack(uintptr_t from) {
+    volatile uint32_t marker = 0;
+    auto end = reinterpret_cast<uintptr_t>(&marker) - kRedZone;
+    for (auto word = reinterpret_cast<volatile uint32_t*>(from);
+         reinterpret_cast<uintptr_t>(word) < end; ++word) {
+        *word = kStackPaint;
+    }
+}
+
+/* Deepest stack usage since the last paint, in bytes below stack_top. */
+uint32_t stackDepth() {
+    auto word = reinterpret_cast<const volatile uint32_t*>(stackBottom());
+    while (reinterpret_cast<uintptr_t>(word) < stack_top &&
+           *word == kStackPaint) {
+        ++word;
+    }
+    return stack_top - reinterpret_cast<uintptr_t>(word);
+}
+
+confirmationui_memory_usage* commandUsage(uint32_t proto, uint32_t cmd) {
+    for (uint32_t i = 0; i < stats.command_count; ++i) {
+        auto& command = stats.commands[i];
+        if (command.proto == proto && command.cmd == cmd) {
+            return &command.usage;
+        }
+    }
+    if (stats.command_count == CONFIRMATIONUI_MEMORY_COMMANDS) {
+        return nullptr;
+    }
+    auto& command = stats.commands[stats.command_count++];
+    command.proto = proto;
+    command.cmd = cmd;
+    return &command.usage;
+}
+
+}  // namespace
+
+__attribute__((noinline)) void init() {
+    stack_top = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+    paintStack(stackBottom());
+}
+
+uint32_t beginPeak() {
+    uint32_t outer = heap_peak;
+    heap_peak = stats.heap_live;
+    return outer;
+}
+
+uint32_t endPeak(uint32_t outer) {
+    uint32_t peak = heap_peak;
+    heap_peak = std::max(outer, peak);
+    return peak;
+}
+
+Scope::Scope(confirmationui_phase phase)
+        : usage_(phase < CONFIRMATIONUI_PHASE_COUNT ? &stats.phases[phase]
+                                                    : nullptr) {
+    begin();
+}
+
+Scope::Scope(uint32_t proto, uint32_t cmd) : usage_(commandUsage(proto, cmd)) {
+    begin();
+}
+
+void Scope::begin() {
+    outer_heap_peak_ = beginPeak();
+    allocs_ = stats.allocs;
+    alloc_bytes_ = stats.alloc_bytes;
+    if (stack_top) {
+        /*
+         * The stack below the deepest word written so far is still painted,
+         * so only what was used since the last paint needs to be repainted.
+         * That erases what the outer scope used so far. Keep it.
+         */
+        uint32_t depth = stackDepth();
+        outer_stack_peak_ = std::max(stack_peak, depth);
+        stack_peak = 0;
+        paintStack(stack_top - depth);
+    }
+}
+
+Scope::~Scope() {
+    uint32_t heap = endPeak(outer_heap_peak_);
+    uint32_t stack = 0;
+    if (stack_top) {
+        stack = std::max(stack_peak, stackDepth());
+        stack_peak = std::max(outer_stack_peak_, stack);
+        stats.stack_peak = std::max(stats.stack_peak, stack);
+    }
+    if (!usage_) {
+        return;
+    }
+    ++usage_->count;
+    usage_->heap_peak = std::max(usage_->heap_peak, heap);
+    usage_->allocs_max =
+            std::max(usage_->allocs_max, uint32_t(stats.allocs - allocs_));
+    usage_->alloc_bytes_max =
+            std::max(usage_->alloc_bytes_max,
+                     uint32_t(stats.alloc_bytes - alloc_bytes_));
+    usage_->stack_peak = std::max(usage_->stack_peak, stack);
+}
+
+const confirmationui_memory& snapshot() {
+    return stats;
+}
+
+}  // namespace memory
+
+/*
+ * Replacements of the C++ allocation functions that account for every
+ * allocation. Like the default ones, they return null if the heap is
+ * exhausted.
+ */
+void* operator new(size_t size) {
+    return memory::allocate(size);
+}
+
+void* operator new[](size_t size) {
+    return memory::allocate(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return memory::allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return memory::allocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    memory::deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    memory::deallocate(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    memory::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    memory::deallocate(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    memory::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    memory::deallocate(ptr);
+}
+
+#endif
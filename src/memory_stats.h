@@ -0,0 +1,100 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "telemetry_proto.h"
+
+/*
+ * Size of the stack reserved in manifest.json (min_stack). The stack below
+ * the frame of main() is painted to measure its depth.
+ */
+#ifndef CONFIRMATIONUI_STACK_BYTES
+#define CONFIRMATIONUI_STACK_BYTES (64 * 1024)
+#endif
+
+namespace memory {
+
+#if CONFIRMATIONUI_MEMORY_STATS
+
+/*
+ * Records the top of the stack and paints the stack below it. Must be called
+ * from main() before any scope is entered.
+ */
+void init();
+
+/*
+ * Starts tracking the heap peak at the current heap usage. Returns the peak
+ * tracked so far, which must be handed to endPeak().
+ */
+uint32_t beginPeak();
+/*
+ * Returns the heap peak since the matching beginPeak() and folds it into the
+ * outer peak.
+ */
+uint32_t endPeak(uint32_t outer);
+
+/*
+ * Records the heap and stack usage between its construction and destruction
+ * for a phase or a command. Scopes may nest.
+ */
+class Scope {
+public:
+    explicit Scope(confirmationui_phase phase);
+    Scope(uint32_t proto, uint32_t cmd);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    void begin();
+
+    confirmationui_memory_usage* usage_;
+    uint32_t outer_heap_peak_;
+    uint32_t outer_stack_peak_;
+    uint64_t allocs_;
+    uint64_t alloc_bytes_;
+};
+
+/* Returns the current counters. */
+const confirmationui_memory& snapshot();
+
+#else
+
+/*
+ * Memory accounting compiles to nothing unless CONFIRMATIONUI_MEMORY_STATS
+ * is set.
+ */
+inline void init() {}
+inline uint32_t beginPeak() {
+    return 0;
+}
+inline uint32_t endPeak(uint32_t) {
+    return 0;
+}
+
+class Scope {
+public:
+    explicit Scope(confirmationui_phase) {}
+    Scope(uint32_t, uint32_t) {}
+};
+
+#endif
+
+}  // namespace memory
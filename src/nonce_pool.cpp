@@ -0,0 +1,67 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nonce_pool.h"
+#include "session_telemetry.h"
+
+#include <lib/rng/trusty_rng.h>
+
+#include <openssl/mem.h>
+
+#include <uapi/err.h>
+
+using secure_input::Nonce;
+using teeui::optional;
+
+static optional<Nonce> getNonce() {
+    Nonce result;
+    if (trusty_rng_secure_rand(result.data(), result.size()) == NO_ERROR) {
+        return result;
+    } else {
+        return {};
+    }
+}
+
+bool NoncePool::fill() {
+    while (count_ < kCapacity) {
+        auto& slot = nonces_[count_];
+        if (trusty_rng_secure_rand(slot.data(), slot.size()) != NO_ERROR) {
+            OPENSSL_cleanse(slot.data(), slot.size());
+            return false;
+        }
+        ++count_;
+    }
+    return true;
+}
+
+optional<Nonce> NoncePool::take() {
+    if (count_ == 0) {
+        telemetry::count(CONFIRMATIONUI_COUNTER_NONCE_POOL_MISS);
+        return getNonce();
+    }
+    telemetry::count(CONFIRMATIONUI_COUNTER_NONCE_POOL_HIT);
+    auto& slot = nonces_[--count_];
+    Nonce result = slot;
+    OPENSSL_cleanse(slot.data(), slot.size());
+    return result;
+}
+
+void NoncePool::clear() {
+    for (auto& nonce : nonces_) {
+        OPENSSL_cleanse(nonce.data(), nonce.size());
+    }
+    count_ = 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <secure_input/secure_input_proto.h>
+#include <teeui/utils.h>
+
+/*
+ * NoncePool holds a few secure random nonces generated ahead of time, so that
+ * the input handshake does not have to wait for the RNG. Every nonce is handed
+ * out at most once and its slot is wiped when it is taken.
+ */
+class NoncePool {
+public:
+    /*
+     * A session needs one nonce for the initial handshake and one for the
+     * handshake following the first power button press.
+     */
+    static constexpr const uint32_t kCapacity = 2;
+
+    NoncePool() : count_(0) {}
+    ~NoncePool() { clear(); }
+
+    /* Tops up the pool. Returns false if the RNG failed. */
+    bool fill();
+
+    /*
+     * Takes a nonce from the pool. Falls back to generating one synchronously
+     * if the pool is empty.
+     */
+    teeui::optional<secure_input::Nonce> take();
+
+    /* Wipes all pooled nonces. */
+    void clear();
+
+    NoncePool(const NoncePool&) = delete;
+    NoncePool& operator=(const NoncePool&) = delete;
+
+private:
+    secure_input::Nonce nonces_[kCapacity];
+    uint32_t count_;
+};
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "offscreen_frame.h"
+
+#include <string.h>
+
+#include <new>
+
+bool OffscreenFrame::allocate(uint32_t width, uint32_t height) {
+    if (pixels_ && width == width_ && height == height_) {
+        return true;
+    }
+    release();
+    size_t count = size_t(width) * height;
+    if (count == 0) {
+        return false;
+    }
+    pixels_.reset(new (std::nothrow) uint32_t[count]);
+    if (!pixels_) {
+        return false;
+    }
+    width_ = width;
+    height_ = height;
+    return true;
+}
+
+void OffscreenFrame::release() {
+    pixels_.reset();
+    width_ = 0;
+    height_ = 0;
+}
+
+RenderTarget OffscreenFrame::target() const {
+    uint32_t stride = width_ * sizeof(uint32_t);
+    return {reinterpret_cast<uint8_t*>(pixels_.get()),
+            stride * height_,
+            width_,
+            height_,
+            stride,
+            sizeof(uint32_t)};
+}
+
+bool OffscreenFrame::copyTo(const RenderTarget& dst) const {
+    auto src = target();
+    if (!pixels_ || dst.width != width_ || dst.height != height_ ||
+        dst.pixel_stride != src.pixel_stride ||
+        dst.line_stride < src.line_stride ||
+        size_t(dst.line_stride) * (height_ - 1) + src.line_stride > dst.size) {
+        return false;
+    }
+    if (dst.line_stride == src.line_stride) {
+        memcpy(dst.buffer, src.buffer, src.size);
+        return true;
+    }
+    for (uint32_t y = 0; y < height_; ++y) {
+        memcpy(dst.buffer + y * dst.line_stride,
+               src.buffer + y * src.line_stride, src.line_stride);
+    }
+    return true;
+}
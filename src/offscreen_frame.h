@@ -0,0 +1,74 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+#include <lib/secure_fb/secure_fb.h>
+
+/*
+ * RenderTarget describes an RGBA8 pixel buffer the renderer can draw into. It
+ * does not own the buffer. It may refer to a secure framebuffer or to an
+ * OffscreenFrame.
+ */
+struct RenderTarget {
+    uint8_t* buffer;
+    uint32_t size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t line_stride;
+    uint32_t pixel_stride;
+
+    static RenderTarget fromSecureFb(const secure_fb_info& fb_info) {
+        return {fb_info.buffer,      fb_info.size,        fb_info.width,
+                fb_info.height,      fb_info.line_stride, fb_info.pixel_stride};
+    }
+};
+
+/*
+ * OffscreenFrame is a heap allocated, cacheable RGBA8 frame with the same
+ * geometry as a secure framebuffer.
+ */
+class OffscreenFrame {
+public:
+    OffscreenFrame() : width_(0), height_(0) {}
+
+    /*
+     * (Re)allocates the frame. Returns false if the heap is exhausted, in which
+     * case the frame is left empty. Reuses the current allocation if the
+     * geometry does not change.
+     */
+    bool allocate(uint32_t width, uint32_t height);
+    void release();
+
+    bool isAllocated() const { return bool(pixels_); }
+    RenderTarget target() const;
+
+    /*
+     * Copies the frame into the given target which must have the same width
+     * and height. Returns false otherwise.
+     */
+    bool copyTo(const RenderTarget& dst) const;
+
+private:
+    std::unique_ptr<uint32_t[]> pixels_;
+    uint32_t width_;
+    uint32_t height_;
+};
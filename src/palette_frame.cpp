@@ -0,0 +1,142 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "palette_frame.h"
+
+#include <new>
+
+using teeui::Color;
+using teeui::Error;
+
+namespace {
+
+constexpr uint16_t pack(uint32_t top, uint32_t bottom, uint32_t coverage) {
+    return uint16_t((top << 12) | (bottom << 8) | coverage);
+}
+
+constexpr uint32_t topSlot(uint16_t pixel) {
+    return pixel >> 12;
+}
+
+constexpr uint32_t bottomSlot(uint16_t pixel) {
+    return (pixel >> 8) & 0xf;
+}
+
+constexpr uint32_t coverage(uint16_t pixel) {
+    return pixel & 0xff;
+}
+
+constexpr uint16_t kBackgroundPixel =
+        pack(uint32_t(PaletteSlot::Background),
+             uint32_t(PaletteSlot::Background),
+             0xff);
+
+uint32_t blendChannel(uint32_t shift, uint32_t alpha, Color a, Color b) {
+    a = (a >> shift) & 0xff;
+    b = (b >> shift) & 0xff;
+    return ((a * alpha + b * (0xff - alpha) + 0x7f) / 0xff) << shift;
+}
+
+}  // namespace
+
+bool PaletteFrame::allocate(uint32_t width, uint32_t height) {
+    if (pixels_ && width == width_ && height == height_) {
+        return true;
+    }
+    release();
+    size_t count = size_t(width) * height;
+    if (count == 0) {
+        return false;
+    }
+    pixels_.reset(new (std::nothrow) uint16_t[count]);
+    if (!pixels_) {
+        return false;
+    }
+    width_ = width;
+    height_ = height;
+    return true;
+}
+
+void PaletteFrame::release() {
+    pixels_.reset();
+    width_ = 0;
+    height_ = 0;
+}
+
+void PaletteFrame::clear() {
+    size_t count = size_t(width_) * height_;
+    for (size_t i = 0; i < count; ++i) {
+        pixels_[i] = kBackgroundPixel;
+    }
+}
+
+Error PaletteFrame::drawPixel(uint32_t x, uint32_t y, Color color) {
+    if (x >= width_ || y >= height_) {
+        return Error::OutOfBoundsDrawing;
+    }
+    uint32_t slot = uint32_t(sentinelSlot(color));
+    if (slot >= uint32_t(PaletteSlot::Count)) {
+        return Error::UnsupportedPixelFormat;
+    }
+    uint32_t alpha = color >> 24;
+    if (alpha == 0) {
+        return Error::OK;
+    }
+
+    auto& pixel = pixels_[size_t(y) * width_ + x];
+    uint32_t top = topSlot(pixel);
+    uint32_t cov = coverage(pixel);
+    if (alpha == 0xff) {
+        pixel = pack(slot, slot, 0xff);
+    } else if (top == slot) {
+        /* Same color on top. Accumulate the coverage. */
+        pixel = pack(slot, bottomSlot(pixel),
+                     cov + ((0xff - cov) * alpha + 0x7f) / 0xff);
+    } else {
+        uint32_t under = cov >= 0x80 ? top : bottomSlot(pixel);
+        pixel = pack(slot, under, alpha);
+    }
+    return Error::OK;
+}
+
+bool PaletteFrame::expand(const Palette& palette,
+                          const RenderTarget& dst) const {
+    if (!pixels_ || dst.width != width_ || dst.height != height_ ||
+        dst.pixel_stride != sizeof(uint32_t) ||
+        size_t(dst.line_stride) * (height_ - 1) + width_ * sizeof(uint32_t) >
+                dst.size) {
+        return false;
+    }
+    const uint16_t* src = pixels_.get();
+    for (uint32_t y = 0; y < height_; ++y) {
+        auto line = reinterpret_cast<uint32_t*>(dst.buffer +
+                                                size_t(y) * dst.line_stride);
+        for (uint32_t x = 0; x < width_; ++x) {
+            uint16_t pixel = *src++;
+            uint32_t alpha = coverage(pixel);
+            Color top = palette[topSlot(pixel)];
+            if (alpha == 0xff) {
+                line[x] = top;
+                continue;
+            }
+            Color bottom = palette[bottomSlot(pixel)];
+            line[x] = 0xff000000 | blendChannel(0, alpha, top, bottom) |
+                      blendChannel(8, alpha, top, bottom) |
+                      blendChannel(16, alpha, top, bottom);
+        }
+    }
+    return true;
+}
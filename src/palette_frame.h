@@ -0,0 +1,101 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <memory>
+
+#include <teeui/error.h>
+#include <teeui/utils.h>
+
+#include "offscreen_frame.h"
+
+/*
+ * The color roles of the confirmation UI. A palette maps each role to a
+ * color. Which color a role gets depends on the color scheme and, for the
+ * instructions, on whether input is enabled.
+ */
+enum class PaletteSlot : uint8_t {
+    Background,
+    Text,
+    Hint,
+    Shield,
+    Button,
+    ButtonBackground,
+    Instruction,
+    // insert new slots above
+    Count,
+};
+
+using Palette = std::array<teeui::Color, size_t(PaletteSlot::Count)>;
+
+/*
+ * Layouts rendered into a PaletteFrame use sentinel colors that carry the
+ * slot in the low bits instead of a real color. Coverage is passed in the
+ * alpha channel as usual.
+ */
+constexpr teeui::Color paletteSentinel(PaletteSlot slot) {
+    return 0xff000000 | uint32_t(slot);
+}
+
+constexpr PaletteSlot sentinelSlot(teeui::Color color) {
+    return PaletteSlot(color & 0xf);
+}
+
+/*
+ * PaletteFrame is an offscreen frame that stores, for every pixel, the slot
+ * of the color drawn on top, the slot of the color underneath, and the
+ * coverage of the top color. Changing the color scheme or the instruction
+ * color only requires expanding the frame with a different palette. Glyphs
+ * and shapes are not rasterized again.
+ *
+ * A pixel takes two bytes: top slot, bottom slot, and eight bit coverage.
+ * Where more than two colors meet in one pixel, the dominant of the colors
+ * underneath is kept.
+ */
+class PaletteFrame {
+public:
+    PaletteFrame() : width_(0), height_(0) {}
+
+    /*
+     * (Re)allocates the frame. Returns false if the heap is exhausted, in which
+     * case the frame is left empty.
+     */
+    bool allocate(uint32_t width, uint32_t height);
+    void release();
+    bool isAllocated() const { return bool(pixels_); }
+
+    /* Sets every pixel to PaletteSlot::Background. */
+    void clear();
+
+    /* Draws a sentinel colored pixel. See paletteSentinel(). */
+    teeui::Error drawPixel(uint32_t x, uint32_t y, teeui::Color color);
+
+    /*
+     * Resolves the frame with the given palette and writes it into the target,
+     * which must have the same width and height. Returns false otherwise.
+     */
+    bool expand(const Palette& palette, const RenderTarget& dst) const;
+
+private:
+    std::unique_ptr<uint16_t[]> pixels_;
+    uint32_t width_;
+    uint32_t height_;
+};
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "prompt_preflight.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <iterator>
+
+#if __has_include(<layouts/prompt_coverage.h>)
+#include <layouts/prompt_coverage.h>
+#define HAVE_PROMPT_COVERAGE 1
+#endif
+
+using teeui::ResponseCode;
+
+namespace {
+
+/*
+ * Decodes the sequence at *pos and advances past it. Returns false if the
+ * sequence is malformed.
+ */
+bool decode(const uint8_t** pos, uint32_t* codepoint) {
+    const uint8_t* p = *pos;
+    uint32_t c = *p++;
+    size_t continuation;
+    uint32_t min;
+    if (c < 0x80) {
+        *codepoint = c;
+        *pos = p;
+        return true;
+    } else if ((c & 0xe0) == 0xc0) {
+        c &= 0x1f;
+        continuation = 1;
+        min = 0x80;
+    } else if ((c & 0xf0) == 0xe0) {
+        c &= 0x0f;
+        continuation = 2;
+        min = 0x800;
+    } else if ((c & 0xf8) == 0xf0) {
+        c &= 0x07;
+        continuation = 3;
+        min = 0x10000;
+    } else {
+        return false;
+    }
+    for (; continuation; --continuation) {
+        /* This also stops at the terminating NUL. */
+        if ((*p & 0xc0) != 0x80) {
+            return false;
+        }
+        c = (c << 6) | (*p++ & 0x3f);
+    }
+    if (c < min || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff)) {
+        return false;
+    }
+    *codepoint = c;
+    *pos = p;
+    return true;
+}
+
+#if HAVE_PROMPT_COVERAGE
+bool hasGlyph(uint32_t codepoint) {
+    using font_coverage::kPromptCoverage;
+    /* Line breaks are handled by the layout and need no glyph. */
+    if (codepoint == '\n') {
+        return true;
+    }
+    auto range = std::upper_bound(
+            std::begin(kPromptCoverage), std::end(kPromptCoverage), codepoint,
+            [](uint32_t c, const font_coverage::Range& r) {
+                return c < r.first;
+            });
+    return range != std::begin(kPromptCoverage) &&
+           codepoint <= std::prev(range)->last;
+}
+#else
+bool hasGlyph(uint32_t) {
+    return true;
+}
+#endif
+
+}  // namespace
+
+ResponseCode preflightPrompt(const char* prompt) {
+    auto pos = reinterpret_cast<const uint8_t*>(prompt);
+    while (*pos) {
+        uint32_t codepoint;
+        if (!decode(&pos, &codepoint)) {
+            return ResponseCode::UIErrorMalformedUTF8Encoding;
+        }
+        if (!hasGlyph(codepoint)) {
+            return ResponseCode::UIErrorMissingGlyph;
+        }
+    }
+    return ResponseCode::OK;
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <teeui/msg_formatting.h>
+
+/*
+ * Checks in one pass over the prompt that it is well formed UTF-8 and that
+ * the prompt font has a glyph for every codepoint, so that a prompt that
+ * cannot be rendered is rejected before the framebuffer is opened.
+ *
+ * Returns ResponseCode::UIErrorMalformedUTF8Encoding for overlong, truncated
+ * or surrogate sequences and ResponseCode::UIErrorMissingGlyph for
+ * codepoints the font lacks. The glyph check is skipped if the layouts do not
+ * provide <layouts/prompt_coverage.h>.
+ */
+teeui::ResponseCode preflightPrompt(const char* prompt);
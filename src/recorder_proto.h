@@ -0,0 +1,103 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <teeui/msg_formatting.h>
+
+/*
+ * This header is the only definition of the interface. The normal world tool
+ * in tools/replay includes it from here.
+ *
+ * The recorder protocol is an extended protocol (see
+ * teeui::Operation::extendedProtocolHook) that lets a load generator read the
+ * requests the TA handled, so that they can be replayed. It is only served by
+ * TAs built with CONFIRMATIONUI_RECORDER, which must never ship, because the
+ * recording includes prompt content.
+ */
+
+namespace recorder {
+
+constexpr const teeui::Protocol kRecorderProto = 3;
+
+enum class RecorderCommand : uint32_t {
+    Invalid,
+    GetRecording,
+    ResetRecording,
+};
+
+/* Largest chunk of the recording returned by one GetRecording request. */
+constexpr const uint32_t kMaxRecordingChunk = 4096;
+
+/*
+ * Returns up to kMaxRecordingChunk bytes of the recording starting at the
+ * given offset, along with the total size of the recording. The first
+ * request stops the recording, so that reading it does not change it.
+ */
+using GetRecording =
+        teeui::Cmd<RecorderCommand, RecorderCommand::GetRecording, uint32_t>;
+using GetRecordingResponse = teeui::
+        Message<teeui::ResponseCode, uint32_t, teeui::MsgVector<uint8_t>>;
+
+/* Discards the recording and starts a new one. */
+using ResetRecording =
+        teeui::Cmd<RecorderCommand, RecorderCommand::ResetRecording>;
+
+}  // namespace recorder
+
+#define CONFIRMATIONUI_RECORDING_VERSION 1
+
+/*
+ * Record types besides %CONFIRMATIONUI_CMD_INIT and %CONFIRMATIONUI_CMD_MSG.
+ * @CONFIRMATIONUI_RECORD_CLOSE: the channel was closed by either side
+ */
+#define CONFIRMATIONUI_RECORD_CLOSE 0
+
+/**
+ * struct confirmationui_recording_hdr - header of a recording
+ * @version:   %CONFIRMATIONUI_RECORDING_VERSION
+ * @truncated: nonzero if records were dropped because the buffer was full
+ *
+ * The header is followed by a sequence of records.
+ */
+struct __attribute__((__packed__)) confirmationui_recording_hdr {
+    uint32_t version;
+    uint32_t truncated;
+};
+
+/**
+ * struct confirmationui_record - one recorded request
+ * @channel: identifies the channel the request arrived on. Unique within a
+ *           recording.
+ * @cmd:     %CONFIRMATIONUI_CMD_INIT, %CONFIRMATIONUI_CMD_MSG, or
+ *           %CONFIRMATIONUI_RECORD_CLOSE
+ * @time_ms: arrival time in milliseconds since the recording started
+ * @len:     length of the payload that follows the record. For
+ *           %CONFIRMATIONUI_CMD_INIT the payload is the shm_len as uint32_t.
+ *           For %CONFIRMATIONUI_CMD_MSG it is the message read from the
+ *           shared memory. Records of type %CONFIRMATIONUI_RECORD_CLOSE have
+ *           no payload.
+ *
+ * All fields are little endian.
+ */
+struct __attribute__((__packed__)) confirmationui_record {
+    uint32_t channel;
+    uint32_t cmd;
+    uint32_t time_ms;
+    uint32_t len;
+};
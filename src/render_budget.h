@@ -0,0 +1,130 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+
+#include "session_telemetry.h"
+#include "trusty_time_stamper.h"
+
+/*
+ * Time budget for rendering the frame of one display in microseconds. 0
+ * disables the budget.
+ */
+#ifndef CONFIRMATIONUI_RENDER_BUDGET_US
+#define CONFIRMATIONUI_RENDER_BUDGET_US 0
+#endif
+
+/*
+ * Ways to draw an element, from the most to the least expensive. All of them
+ * draw the same glyphs and shapes. Only the smoothing of their edges differs.
+ */
+enum class RenderQuality : uint32_t {
+    /* Anti-aliased and blended with the target. */
+    Full,
+    /*
+     * Shapes are drawn without anti-aliasing, so their pixels are opaque and
+     * are written without reading the target.
+     */
+    AliasedShapes,
+    /*
+     * In addition, text is blended with the solid background color instead of
+     * the target, so the target is never read. This matches Full wherever
+     * the element is drawn over the background. Where pixels of elements or
+     * glyphs overlap, the later one wins instead of blending.
+     */
+    SolidBackground,
+};
+
+/*
+ * RenderBudget picks the quality of each element of a layout with
+ * ElementCount elements while it is rendered. It remembers what each element
+ * cost the last time it was drawn at each quality. Before an element is
+ * drawn, the time spent so far plus the cost of the remaining elements at
+ * the current quality is projected. If that exceeds the budget, the quality
+ * drops one level for the rest of the render, which is counted in telemetry.
+ * The quality drops at most one level per element.
+ * Costs not measured yet are taken from the next better quality.
+ */
+template <size_t ElementCount>
+class RenderBudget {
+public:
+    static constexpr const size_t kQualities =
+            size_t(RenderQuality::SolidBackground) + 1;
+
+    RenderBudget() : cost_us_{}, quality_(RenderQuality::Full) {}
+
+    void begin() {
+        begin_ = monotonic_time_stamper::nowPrecise();
+        quality_ = RenderQuality::Full;
+    }
+
+    /* Returns the quality to draw element i with. */
+    RenderQuality beforeElement(size_t i) {
+        if (quality_ != RenderQuality::SolidBackground &&
+            projectedUs(i) > CONFIRMATIONUI_RENDER_BUDGET_US) {
+            quality_ = RenderQuality(uint32_t(quality_) + 1);
+            telemetry::count(
+                    quality_ == RenderQuality::AliasedShapes
+                            ? CONFIRMATIONUI_COUNTER_DEGRADED_SHAPES
+                            : CONFIRMATIONUI_COUNTER_DEGRADED_BLENDING);
+        }
+        element_begin_ = monotonic_time_stamper::nowPrecise();
+        return quality_;
+    }
+
+    /* Records the cost of element i, which was drawn at the given quality. */
+    void afterElement(size_t i, RenderQuality quality) {
+        auto now = monotonic_time_stamper::nowPrecise();
+        if (i < ElementCount && now.isOk() && element_begin_.isOk() &&
+            now >= element_begin_) {
+            /* 0 means not measured. */
+            cost_us_[size_t(quality)][i] =
+                    std::clamp<uint64_t>(now - element_begin_, 1, UINT32_MAX);
+        }
+    }
+
+private:
+    uint64_t costUs(size_t i) const {
+        for (size_t q = size_t(quality_) + 1; q-- > 0;) {
+            if (cost_us_[q][i]) {
+                return cost_us_[q][i];
+            }
+        }
+        return 0;
+    }
+
+    uint64_t projectedUs(size_t i) const {
+        auto now = monotonic_time_stamper::nowPrecise();
+        uint64_t projected = 0;
+        if (now.isOk() && begin_.isOk() && now >= begin_) {
+            projected = now - begin_;
+        }
+        for (size_t j = i; j < ElementCount; ++j) {
+            projected += costUs(j);
+        }
+        return projected;
+    }
+
+    uint32_t cost_us_[kQualities][ElementCount];
+    RenderQuality quality_;
+    monotonic_time_stamper::PreciseTimeStamp begin_;
+    monotonic_time_stamper::PreciseTimeStamp element_begin_;
+};
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render_sweep.h"
+
+#if CONFIRMATIONUI_RENDER_SWEEP
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <teeui/localization/ConfirmationUITranslations.h>
+#include <trusty_log.h>
+
+#include "memory_stats.h"
+#include "trusty_time_stamper.h"
+
+#define TLOG_TAG "confirmationui"
+
+using teeui::ResponseCode;
+
+namespace sweep {
+
+namespace {
+
+/*
+ * A typical prompt, and a worst case one that wraps over most of the body
+ * with long words and wide glyphs.
+ */
+const char* const kPrompts[] = {
+        "Confirm the payment of $1,234.56 to Example Merchant",
+        "WWWWWWWW MMMMMMMM WWWWWWWW MMMMMMMM WWWWWWWW MMMMMMMM WWWWWWWW "
+        "Transfer 99,999,999.99 EUR from account DE00 0000 0000 0000 0000 00 "
+        "to account FR00 0000 0000 0000 0000 0000 000, reference "
+        "WWWWWWWWWWWWWWWW, on behalf of Example Merchant International "
+        "Holdings Limited. Approve this transaction only if you initiated it "
+        "yourself. WWWWWWWW MMMMMMMM WWWWWWWW MMMMMMMM WWWWWWWW MMMMMMMM",
+};
+
+constexpr size_t kPromptCount = sizeof(kPrompts) / sizeof(kPrompts[0]);
+
+/* Number of ranked entries written to the log. */
+constexpr size_t kLoggedEntries = 10;
+
+uint32_t checksum(const RenderTarget& target) {
+    uint32_t hash = 2166136261u;
+    for (uint32_t y = 0; y < target.height; ++y) {
+        const uint8_t* line = target.buffer + size_t(y) * target.line_stride;
+        for (size_t i = 0; i < size_t(target.width) * target.pixel_stride;
+             ++i) {
+            hash = (hash ^ line[i]) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+/*
+ * Renders the configuration of entry again, limited to path, and returns the
+ * render time in microseconds, or 0 if the render failed. Sets *sum to the
+ * checksum of the frame.
+ */
+uint32_t timePath(TrustyConfirmationUI* gui,
+                  const confirmationui_sweep_entry& entry,
+                  TrustyConfirmationUI::RenderPath path,
+                  OffscreenFrame* frame,
+                  uint32_t* sum) {
+    using monotonic_time_stamper::nowPrecise;
+    auto begin = nowPrecise();
+    auto rc = gui->renderOffscreen(kPrompts[entry.prompt], entry.lang_id,
+                                   entry.inverted, entry.magnified,
+                                   entry.display, frame, path);
+    auto end = nowPrecise();
+    if (rc != ResponseCode::OK) {
+        *sum = 0;
+        return 0;
+    }
+    *sum = checksum(frame->target());
+    return uint32_t(end - begin);
+}
+
+/*
+ * Fills in the direct and tiled render times of entry. Both paths must
+ * produce the same frame.
+ */
+void comparePaths(TrustyConfirmationUI* gui,
+                  confirmationui_sweep_entry* entry,
+                  OffscreenFrame* frame) {
+    using RenderPath = TrustyConfirmationUI::RenderPath;
+    uint32_t direct;
+    uint32_t tiled;
+    entry->direct_us =
+            timePath(gui, *entry, RenderPath::Direct, frame, &direct);
+    entry->tiled_us = timePath(gui, *entry, RenderPath::Tiled, frame, &tiled);
+    if (direct != tiled) {
+        TLOGW("sweep: tiled frame differs from direct frame for %s "
+              "inverted=%u magnified=%u prompt=%u display=%u\n",
+              entry->lang_id, entry->inverted, entry->magnified,
+              entry->prompt, entry->display);
+    }
+}
+
+}  // namespace
+
+ResponseCode run(TrustyConfirmationUI* gui, std::vector<uint8_t>* report) {
+    using monotonic_time_stamper::nowPrecise;
+
+    size_t displays = TrustyConfirmationUI::displayCount();
+    std::vector<confirmationui_sweep_entry> entries;
+    OffscreenFrame frame;
+    for (const char* lang : teeui::localization::getLanguages()) {
+        for (uint8_t inverted = 0; inverted < 2; ++inverted) {
+            for (uint8_t magnified = 0; magnified < 2; ++magnified) {
+                for (uint8_t prompt = 0; prompt < kPromptCount; ++prompt) {
+                    for (uint8_t display = 0; display < displays; ++display) {
+                        confirmationui_sweep_entry entry = {};
+                        strncpy(entry.lang_id, lang,
+                                sizeof(entry.lang_id) - 1);
+                        entry.inverted = inverted;
+                        entry.magnified = magnified;
+                        entry.display = display;
+                        entry.prompt = prompt;
+
+                        uint32_t outer_peak = memory::beginPeak();
+                        auto begin = nowPrecise();
+                        auto rc = gui->renderOffscreen(kPrompts[prompt], lang,
+                                                       inverted, magnified,
+                                                       display, &frame);
+                        auto end = nowPrecise();
+                        entry.heap_peak = memory::endPeak(outer_peak);
+                        if (rc == ResponseCode::OperationPending) {
+                            return rc;
+                        }
+                        auto target = frame.target();
+                        entry.width = target.width;
+                        entry.height = target.height;
+                        entry.status = uint32_t(rc);
+                        entry.render_us = uint32_t(end - begin);
+                        entry.frame_bytes = target.size;
+                        if (rc == ResponseCode::OK) {
+                            entry.checksum = checksum(target);
+                            comparePaths(gui, &entry, &frame);
+                        }
+                        entries.push_back(entry);
+                    }
+                }
+            }
+        }
+    }
+    /* Drop the layouts and frames of the last configuration. */
+    gui->release();
+
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const auto& a, const auto& b) {
+                         return a.render_us > b.render_us;
+                     });
+    for (size_t i = 0; i < entries.size() && i < kLoggedEntries; ++i) {
+        auto& e = entries[i];
+        TLOGI("sweep #%zu: %s inverted=%u magnified=%u prompt=%u display=%u "
+              "(%ux%u): %u us (direct %u us, tiled %u us), status %u\n",
+              i, e.lang_id, e.inverted, e.magnified, e.prompt, e.display,
+              e.width, e.height, e.render_us, e.direct_us, e.tiled_us,
+              e.status);
+    }
+
+    confirmationui_sweep hdr = {
+            CONFIRMATIONUI_SWEEP_VERSION,
+            uint32_t(entries.size()),
+            uint32_t(std::min<size_t>(entries.size(),
+                                      CONFIRMATIONUI_SWEEP_MAX_ENTRIES)),
+    };
+    auto begin = reinterpret_cast<const uint8_t*>(&hdr);
+    report->assign(begin, begin + sizeof(hdr));
+    begin = reinterpret_cast<const uint8_t*>(entries.data());
+    report->insert(report->end(), begin,
+                   begin + hdr.entry_count * sizeof(entries[0]));
+    return ResponseCode::OK;
+}
+
+}  // namespace sweep
+
+#endif
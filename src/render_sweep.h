@@ -0,0 +1,42 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <teeui/msg_formatting.h>
+
+#include "telemetry_proto.h"
+#include "trusty_confirmation_ui.h"
+
+namespace sweep {
+
+/*
+ * Renders every combination of language, color scheme, font profile, sweep
+ * prompt and display with TrustyConfirmationUI::renderOffscreen() and
+ * records the render time, the heap peak and a checksum of each frame.
+ *
+ * On success, report holds a struct confirmationui_sweep followed by the
+ * slowest configurations, slowest first. Returns
+ * ResponseCode::OperationPending if a session is active.
+ */
+teeui::ResponseCode run(TrustyConfirmationUI* gui,
+                        std::vector<uint8_t>* report);
+
+}  // namespace sweep
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "request_recorder.h"
+
+#if CONFIRMATIONUI_RECORDER
+
+#include <string.h>
+
+#include <trusty_log.h>
+
+#include "ipc.h"
+
+#define TLOG_TAG "confirmationui"
+
+using monotonic_time_stamper::PreciseTimeStamp;
+
+namespace recorder {
+
+namespace {
+
+struct Recording {
+    confirmationui_recording_hdr hdr = {CONFIRMATIONUI_RECORDING_VERSION, 0};
+    uint8_t records[CONFIRMATIONUI_RECORDER_BYTES];
+    size_t used = 0;
+    bool stopped = false;
+    uint32_t next_channel = 1;
+    PreciseTimeStamp start;
+};
+
+Recording recording;
+
+void append(uint32_t channel,
+            uint32_t cmd,
+            PreciseTimeStamp time,
+            const void* payload,
+            uint32_t len) {
+    if (recording.stopped) {
+        return;
+    }
+    if (!recording.start.isOk()) {
+        recording.start = time;
+    }
+    confirmationui_record record = {
+            channel,
+            cmd,
+            uint32_t((uint64_t(time) - uint64_t(recording.start)) / 1000),
+            len,
+    };
+    if (sizeof(recording.records) - recording.used < sizeof(record) + len) {
+        if (!recording.hdr.truncated) {
+            TLOGW("Recording buffer is full\n");
+        }
+        recording.hdr.truncated = 1;
+        return;
+    }
+    memcpy(recording.records + recording.used, &record, sizeof(record));
+    recording.used += sizeof(record);
+    memcpy(recording.records + recording.used, payload, len);
+    recording.used += len;
+}
+
+}  // namespace
+
+uint32_t newChannel() {
+    return recording.next_channel++;
+}
+
+void recordInit(uint32_t channel, PreciseTimeStamp time, uint32_t shm_len) {
+    append(channel, CONFIRMATIONUI_CMD_INIT, time, &shm_len, sizeof(shm_len));
+}
+
+void recordMsg(uint32_t channel,
+               PreciseTimeStamp time,
+               const void* msg,
+               uint32_t len) {
+    append(channel, CONFIRMATIONUI_CMD_MSG, time, msg, len);
+}
+
+void recordClose(uint32_t channel) {
+    append(channel, CONFIRMATIONUI_RECORD_CLOSE,
+           monotonic_time_stamper::nowPrecise(), nullptr, 0);
+}
+
+size_t read(uint32_t offset, uint8_t* out, size_t len) {
+    recording.stopped = true;
+    size_t total = size();
+    if (offset >= total) {
+        return 0;
+    }
+    if (len > total - offset) {
+        len = total - offset;
+    }
+    size_t copied = 0;
+    if (offset < sizeof(recording.hdr)) {
+        size_t n = sizeof(recording.hdr) - offset;
+        n = n < len ? n : len;
+        memcpy(out, reinterpret_cast<const uint8_t*>(&recording.hdr) + offset,
+               n);
+        copied = n;
+        offset += n;
+    }
+    memcpy(out + copied, recording.records + (offset - sizeof(recording.hdr)),
+           len - copied);
+    return len;
+}
+
+uint32_t size() {
+    return sizeof(recording.hdr) + recording.used;
+}
+
+void reset() {
+    recording.hdr.truncated = 0;
+    recording.used = 0;
+    recording.stopped = false;
+    recording.start = {};
+}
+
+}  // namespace recorder
+
+#endif
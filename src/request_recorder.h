@@ -0,0 +1,75 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "recorder_proto.h"
+#include "trusty_time_stamper.h"
+
+/*
+ * Size of the recording buffer. Requests that do not fit are dropped and the
+ * recording is marked as truncated.
+ */
+#ifndef CONFIRMATIONUI_RECORDER_BYTES
+#define CONFIRMATIONUI_RECORDER_BYTES (64 * 1024)
+#endif
+
+namespace recorder {
+
+#if CONFIRMATIONUI_RECORDER
+
+/* Returns a new channel id for the records of a channel. */
+uint32_t newChannel();
+
+void recordInit(uint32_t channel,
+                monotonic_time_stamper::PreciseTimeStamp time,
+                uint32_t shm_len);
+void recordMsg(uint32_t channel,
+               monotonic_time_stamper::PreciseTimeStamp time,
+               const void* msg,
+               uint32_t len);
+void recordClose(uint32_t channel);
+
+/*
+ * Copies up to len bytes of the recording, starting at offset, into out.
+ * Stops the recording. Returns the number of bytes copied.
+ */
+size_t read(uint32_t offset, uint8_t* out, size_t len);
+/* Size of the recording including its header. */
+uint32_t size();
+void reset();
+
+#else
+
+/* The recorder compiles to nothing unless CONFIRMATIONUI_RECORDER is set. */
+inline uint32_t newChannel() {
+    return 0;
+}
+inline void recordInit(uint32_t,
+                       monotonic_time_stamper::PreciseTimeStamp,
+                       uint32_t) {}
+inline void recordMsg(uint32_t,
+                      monotonic_time_stamper::PreciseTimeStamp,
+                      const void*,
+                      uint32_t) {}
+inline void recordClose(uint32_t) {}
+
+#endif
+
+}  // namespace recorder
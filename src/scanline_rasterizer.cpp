@@ -0,0 +1,191 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "scanline_rasterizer.h"
+
+#include <math.h>
+
+using teeui::Color;
+using teeui::Error;
+
+namespace scanline {
+
+namespace {
+
+/* Horizontal extent of a shape on one sub-row. Empty if left >= right. */
+struct Span {
+    double left;
+    double right;
+
+    bool empty() const { return left >= right; }
+};
+
+Color withCoverage(Color color, double coverage) {
+    uint32_t alpha = (color >> 24) * coverage + 0.5;
+    if (alpha > 0xff) {
+        alpha = 0xff;
+    }
+    return (color & 0xffffff) | (alpha << 24);
+}
+
+double overlap(double a0, double a1, double b0, double b1) {
+    double lo = a0 > b0 ? a0 : b0;
+    double hi = a1 < b1 ? a1 : b1;
+    return hi > lo ? hi - lo : 0;
+}
+
+/*
+ * Rasterizes the shape described by span_at(y), which returns the horizontal
+ * extent of the shape at the vertical position y, within [top, bottom).
+ */
+template <typename SpanAt>
+Error rasterize(double top,
+                double bottom,
+                Color color,
+                const Clip& clip,
+                const teeui::PixelDrawer& drawPixel,
+                const SpanAt& span_at) {
+    int64_t first_row = floor(top);
+    int64_t last_row = ceil(bottom);
+    if (first_row < clip.top) {
+        first_row = clip.top;
+    }
+    if (last_row > clip.bottom) {
+        last_row = clip.bottom;
+    }
+
+    Span spans[kSubRows];
+    for (int64_t y = first_row; y < last_row; ++y) {
+        /* inner is covered by all sub-rows, outer by at least one. */
+        double inner_left = INFINITY, inner_right = -INFINITY;
+        double outer_left = INFINITY, outer_right = -INFINITY;
+        bool all_rows = true;
+        for (uint32_t s = 0; s < kSubRows; ++s) {
+            double sy = y + (s + 0.5) / kSubRows;
+            spans[s] = sy >= top && sy < bottom ? span_at(sy) : Span{0, 0};
+            if (spans[s].empty()) {
+                all_rows = false;
+                continue;
+            }
+            outer_left = fmin(outer_left, spans[s].left);
+            outer_right = fmax(outer_right, spans[s].right);
+            inner_left = fmax(inner_left, spans[s].left);
+            inner_right = fmin(inner_right, spans[s].right);
+        }
+        if (!(outer_left < outer_right)) {
+            continue;
+        }
+
+        int64_t solid_begin = all_rows ? ceil(inner_left) : 0;
+        int64_t solid_end = all_rows ? floor(inner_right) : 0;
+        if (solid_end < solid_begin) {
+            solid_end = solid_begin;
+        }
+        int64_t x_begin = floor(outer_left);
+        int64_t x_end = ceil(outer_right);
+        if (x_begin < clip.left) {
+            x_begin = clip.left;
+        }
+        if (x_end > clip.right) {
+            x_end = clip.right;
+        }
+
+        for (int64_t x = x_begin; x < x_end; ++x) {
+            Color pixel = color;
+            if (x < solid_begin || x >= solid_end) {
+                double coverage = 0;
+                for (auto& span : spans) {
+                    if (!span.empty()) {
+                        coverage += overlap(x, x + 1, span.left, span.right);
+                    }
+                }
+                coverage /= kSubRows;
+                if (coverage <= 0) {
+                    continue;
+                }
+                pixel = withCoverage(color, coverage);
+            }
+            if (auto error = drawPixel(x, y, pixel)) {
+                return error;
+            }
+        }
+    }
+    return Error::OK;
+}
+
+}  // namespace
+
+Error fillConvex(const Point* begin,
+                 const Point* end,
+                 Color color,
+                 const Clip& clip,
+                 const teeui::PixelDrawer& drawPixel) {
+    if (end - begin < 3) {
+        return Error::OK;
+    }
+    double top = INFINITY, bottom = -INFINITY;
+    for (auto p = begin; p != end; ++p) {
+        top = fmin(top, p->y);
+        bottom = fmax(bottom, p->y);
+    }
+    return rasterize(top, bottom, color, clip, drawPixel, [&](double y) {
+        Span span = {INFINITY, -INFINITY};
+        for (auto a = begin; a != end; ++a) {
+            auto b = a + 1 == end ? begin : a + 1;
+            if ((y < a->y) == (y < b->y)) {
+                continue;
+            }
+            double x = a->x + (y - a->y) * (b->x - a->x) / (b->y - a->y);
+            span.left = fmin(span.left, x);
+            span.right = fmax(span.right, x);
+        }
+        return span;
+    });
+}
+
+Error fillRoundedRect(const RoundedRect& rect,
+                      Color color,
+                      const Clip& clip,
+                      const teeui::PixelDrawer& drawPixel) {
+    double r = rect.radius;
+    /* Horizontal inset of a corner arc at the vertical distance dy from the
+     * arc's center line. */
+    auto inset = [r](double dy) {
+        return dy <= 0 ? 0 : r - sqrt(fmax(r * r - dy * dy, 0));
+    };
+    return rasterize(
+            rect.top, rect.bottom, color, clip, drawPixel, [&](double y) {
+                double dy_top = rect.top + r - y;
+                double dy_bottom = y - (rect.bottom - r);
+                Span span = {rect.left, rect.right};
+                if (rect.round_top_left) {
+                    span.left = fmax(span.left, rect.left + inset(dy_top));
+                }
+                if (rect.round_bottom_left) {
+                    span.left = fmax(span.left, rect.left + inset(dy_bottom));
+                }
+                if (rect.round_top_right) {
+                    span.right = fmin(span.right, rect.right - inset(dy_top));
+                }
+                if (rect.round_bottom_right) {
+                    span.right =
+                            fmin(span.right, rect.right - inset(dy_bottom));
+                }
+                return span;
+            });
+}
+
+}  // namespace scanline
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <teeui/error.h>
+#include <teeui/utils.h>
+
+/*
+ * Scanline rasterizer for the shapes of the button elements. Each pixel row is
+ * sampled at kSubRows sub-rows. For each sub-row the left and right edge of
+ * the shape are computed analytically. Pixels covered by every sub-row span
+ * are filled solid. Only the pixels between the outermost and the innermost
+ * edges get a partial coverage. Coverage is evaluated in time proportional
+ * to the perimeter of the shape instead of its area.
+ *
+ * All coordinates are in pixels in the coordinate system of the PixelDrawer.
+ */
+namespace scanline {
+
+constexpr const uint32_t kSubRows = 4;
+
+struct Point {
+    double x;
+    double y;
+};
+
+/* Pixels outside of [left, right) x [top, bottom) are never drawn. */
+struct Clip {
+    int64_t left;
+    int64_t top;
+    int64_t right;
+    int64_t bottom;
+};
+
+struct RoundedRect {
+    double left;
+    double top;
+    double right;
+    double bottom;
+    double radius;
+    bool round_top_left;
+    bool round_top_right;
+    bool round_bottom_left;
+    bool round_bottom_right;
+};
+
+/*
+ * Fills the convex polygon given by the points in order. Either winding
+ * direction is accepted.
+ */
+teeui::Error fillConvex(const Point* begin,
+                        const Point* end,
+                        teeui::Color color,
+                        const Clip& clip,
+                        const teeui::PixelDrawer& drawPixel);
+
+teeui::Error fillRoundedRect(const RoundedRect& rect,
+                             teeui::Color color,
+                             const Clip& clip,
+                             const teeui::PixelDrawer& drawPixel);
+
+}  // namespace scanline
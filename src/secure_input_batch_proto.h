@@ -0,0 +1,74 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <secure_input/secure_input_proto.h>
+#include <teeui/msg_formatting.h>
+
+/*
+ * The normal world input driver that sends batches must use the same
+ * encoding. kDeliverInputEventBatch is not an enumerator of
+ * SecureInputCommand, which belongs to libteeui, so handlers check for it
+ * before switching over the enumerators.
+ *
+ * Batched input event delivery extends kSecureInputProto with one command
+ * that delivers an ordered sequence of key events under a single signature.
+ * A confirmation (two power button presses) then takes one round trip and one
+ * MAC verification instead of two of each.
+ */
+
+namespace secure_input {
+
+constexpr const SecureInputCommand kDeliverInputEventBatch =
+        static_cast<SecureInputCommand>(4);
+
+constexpr const uint32_t kMaxInputEventBatchSize = 8;
+
+constexpr const char kConfirmationUIEventBatchLabel[] =
+        "DTup input event batch";
+
+/**
+ * struct input_event_record - one event of a batch
+ * @key_event: DTupKeyEvent in big endian byte order
+ * @offset_ms: time of the event in milliseconds relative to the first event of
+ *             the batch in big endian byte order. Offsets must not decrease.
+ *
+ * The events argument of DeliverInputEventBatch is the concatenation of 1 to
+ * kMaxInputEventBatchSize records. The signature is
+ * HMAC(key, kConfirmationUIEventBatchLabel || events || nonce), where nonce is
+ * the nonce established by the preceding handshake.
+ */
+struct __attribute__((__packed__)) input_event_record {
+    uint32_t key_event;
+    uint32_t offset_ms;
+};
+
+using DeliverInputEventBatch = teeui::Cmd<SecureInputCommand,
+                                          kDeliverInputEventBatch,
+                                          teeui::MsgVector<uint8_t>,
+                                          Signature>;
+/*
+ * The response carries one InputResponse per event, encoded as one byte each,
+ * in the order of the batch. Events after the one that concluded the session
+ * are not processed and report InputResponse::TIMED_OUT.
+ */
+using DeliverInputEventBatchResponse =
+        teeui::Message<teeui::ResponseCode, teeui::MsgVector<uint8_t>>;
+
+}  // namespace secure_input
@@ -15,14 +15,14 @@
  */
 
 #include "secure_input_tracker.h"
+#include "secure_input_batch_proto.h"
 #include "trusty_operation.h"
 
 #include <secure_input/secure_input_proto.h>
 
-#include <lib/rng/trusty_rng.h>
-
 #include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <teeui/utils.h>
 
@@ -34,29 +34,20 @@
 
 using namespace secure_input;
 using teeui::Array;
-using teeui::AuthTokenKey;
 using teeui::bytesCast;
-using teeui::HMac;
 using teeui::optional;
 using teeui::ResponseCode;
 
-inline auto mtsNow() {
-    return monotonic_time_stamper::now();
-}
+using monotonic_time_stamper::TimeStamp;
 
-static optional<Nonce> getNonce() {
-    Nonce result;
-    if (trusty_rng_secure_rand(result.data(), result.size()) == NO_ERROR) {
-        return result;
-    } else {
-        return {};
-    }
+bool InputTracker::fillNoncePool() {
+    return nonce_pool_.fill();
 }
 
-ResponseCode InputTracker::newSession() {
+ResponseCode InputTracker::newSession(TimeStamp now) {
     state_ = InputState::Fresh;
     event_ = InputEvent::None;
-    auto now = mtsNow();
+    pending_press_ = false;
     // Initialize all timestamps to something sane.
     for (auto& t : timestamps_) {
         t = now;
@@ -65,14 +56,13 @@ ResponseCode InputTracker::newSession() {
 }
 
 // input Handshake
-std::tuple<ResponseCode, Nonce> InputTracker::beginHandshake() {
+std::tuple<ResponseCode, Nonce> InputTracker::beginHandshake(TimeStamp now) {
     ResponseCode rc;
-    auto now = mtsNow();
     if ((state_ == InputState::Fresh &&
          (now - timestamps_[uint32_t(InputState::Fresh)]) >=
                  kUserPreInputGracePeriodMillis) ||
         state_ == InputState::InputDeliveredMorePending) {
-        auto nonce = getNonce();
+        auto nonce = nonce_pool_.take();
         if (nonce) {
             input_nonce_ = *nonce;
             TLOGD("%u", uint32_t(state_));
@@ -91,18 +81,18 @@ std::tuple<ResponseCode, Nonce> InputTracker::beginHandshake() {
 // input Handshake finalize
 ResponseCode InputTracker::finalizeHandshake(const Nonce& nCi,
                                              const Signature& signature,
-                                             const AuthTokenKey& key) {
+                                             const HmacKeySchedule& hmacer,
+                                             TimeStamp now) {
     ResponseCode rc;
     if (state_ == InputState::HandshakeOutstanding) {
-        using HMacer = HMac<TrustyOperation>;
-        auto hmac = HMacer::hmac256(key, kConfirmationUIHandshakeLabel,
-                                    input_nonce_, nCi);
+        auto hmac = hmacer.mac(HmacKeySchedule::Label::Handshake,
+                               {input_nonce_, nCi});
         if (hmac) {
             if (*hmac == signature) {
                 // we can forget the nCo and input_nonce now becomes nCi
                 input_nonce_ = nCi;
                 state_ = InputState::HandshakeComplete;
-                timestamps_[uint32_t(state_)] = mtsNow();
+                timestamps_[uint32_t(state_)] = now;
                 TLOGD("%u", uint32_t(state_));
                 return ResponseCode::OK;
             } else {
@@ -122,13 +112,12 @@ ResponseCode InputTracker::finalizeHandshake(const Nonce& nCi,
 std::tuple<ResponseCode, InputResponse> InputTracker::processInputEvent(
         DTupKeyEvent keyEvent,
         const Signature& signature,
-        const AuthTokenKey& key) {
+        const HmacKeySchedule& hmacer,
+        TimeStamp now) {
     std::tuple<ResponseCode, InputResponse> result = {ResponseCode::OK,
                                                       InputResponse::TIMED_OUT};
     ResponseCode& rc = std::get<0>(result);
     InputResponse& ir = std::get<1>(result);
-    using HMacer = HMac<TrustyOperation>;
-    auto now = mtsNow();
 
     if (state_ != InputState::HandshakeComplete) {
         state_ = InputState::None;
@@ -136,8 +125,8 @@ std::tuple<ResponseCode, InputResponse> InputTracker::processInputEvent(
         return result;
     }
     uint32_t keyEventBE = htobe32(static_cast<uint32_t>(keyEvent));
-    auto hmac = HMacer::hmac256(key, kConfirmationUIEventLabel,
-                                bytesCast(keyEventBE), input_nonce_);
+    auto hmac = hmacer.mac(HmacKeySchedule::Label::Event,
+                           {bytesCast(keyEventBE), input_nonce_});
     if (!hmac) {
         state_ = InputState::None;
         rc = ResponseCode::SystemError;
@@ -151,37 +140,136 @@ std::tuple<ResponseCode, InputResponse> InputTracker::processInputEvent(
         return result;
     }
 
+    rc = applyKeyEvent(keyEvent, now, &ir);
+    return result;
+}
+
+std::tuple<ResponseCode, std::vector<InputResponse>>
+InputTracker::processInputEventBatch(const teeui::MsgVector<uint8_t>& events,
+                                     const Signature& signature,
+                                     const HmacKeySchedule& hmacer,
+                                     TimeStamp now) {
+    std::tuple<ResponseCode, std::vector<InputResponse>> result = {
+            ResponseCode::OK, {}};
+    ResponseCode& rc = std::get<0>(result);
+    auto& responses = std::get<1>(result);
+
+    if (state_ != InputState::HandshakeComplete) {
+        state_ = InputState::None;
+        rc = ResponseCode::Unexpected;
+        return result;
+    }
+
+    size_t count = events.size() / sizeof(input_event_record);
+    if (count == 0 || count > kMaxInputEventBatchSize ||
+        events.size() % sizeof(input_event_record)) {
+        TLOGE("malformed input event batch (%zu bytes)\n", events.size());
+        state_ = InputState::None;
+        rc = ResponseCode::Unexpected;
+        return result;
+    }
+
+    auto hmac = hmacer.mac(HmacKeySchedule::Label::EventBatch,
+                           {events, input_nonce_});
+    if (!hmac) {
+        state_ = InputState::None;
+        rc = ResponseCode::SystemError;
+        return result;
+    }
+    if (!(*hmac == signature)) {
+        state_ = InputState::None;
+        rc = ResponseCode::Aborted;
+        TLOGE("signature on input event batch did not check out");
+        return result;
+    }
+
+    input_event_record records[kMaxInputEventBatchSize];
+    memcpy(records, events.data(), events.size());
+    uint32_t lastOffset = be32toh(records[count - 1].offset_ms);
+    uint32_t previousOffset = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t offset = be32toh(records[i].offset_ms);
+        if (offset < previousOffset) {
+            TLOGE("input event batch is not ordered\n");
+            state_ = InputState::None;
+            rc = ResponseCode::Unexpected;
+            return result;
+        }
+        previousOffset = offset;
+    }
+    /*
+     * Like single events, batched events must follow the handshake, and with
+     * it the grace period before input. The events are ordered, so checking
+     * the first one covers the batch.
+     */
+    TimeStamp handshake = timestamps_[uint32_t(InputState::HandshakeComplete)];
+    if (now < handshake ||
+        lastOffset - be32toh(records[0].offset_ms) > now - handshake) {
+        TLOGE("input event batch predates the handshake\n");
+        state_ = InputState::None;
+        rc = ResponseCode::Unexpected;
+        return result;
+    }
+
+    /*
+     * The batch was signed as a whole, so within the batch a pending first
+     * press counts as a completed handshake for the next event. The last event
+     * happened at the time of dispatch.
+     */
+    responses.resize(count, InputResponse::TIMED_OUT);
+    for (size_t i = 0; i < count; ++i) {
+        if (state_ == InputState::InputDeliveredFinal) {
+            break;
+        }
+        if (state_ == InputState::InputDeliveredMorePending) {
+            state_ = InputState::HandshakeComplete;
+        }
+        auto keyEvent =
+                static_cast<DTupKeyEvent>(be32toh(records[i].key_event));
+        TimeStamp at = now - (lastOffset - be32toh(records[i].offset_ms));
+        rc = applyKeyEvent(keyEvent, at, &responses[i]);
+        if (rc != ResponseCode::OK) {
+            return result;
+        }
+    }
+    return result;
+}
+
+ResponseCode InputTracker::applyKeyEvent(DTupKeyEvent keyEvent,
+                                         TimeStamp now,
+                                         InputResponse* ir) {
     switch (keyEvent) {
     // fall through intended
     case DTupKeyEvent::VOL_DOWN:
     case DTupKeyEvent::VOL_UP:
         event_ = InputEvent::UserCancel;
         state_ = InputState::InputDeliveredFinal;
-        ir = InputResponse::OK;
+        *ir = InputResponse::OK;
         break;
     case DTupKeyEvent::PWR:
-        if (state_ == InputState::HandshakeComplete &&
+        if (state_ == InputState::HandshakeComplete && pending_press_ &&
             now - timestamps_[uint32_t(
                           InputState::InputDeliveredMorePending)] <=
                     kUserDoupleClickTimeoutMillis) {
             state_ = InputState::InputDeliveredFinal;
-            ir = InputResponse::OK;
+            *ir = InputResponse::OK;
             event_ = InputEvent::UserConfirm;
+            pending_press_ = false;
         } else {
             state_ = InputState::InputDeliveredMorePending;
-            ir = InputResponse::PENDING_MORE;
+            *ir = InputResponse::PENDING_MORE;
+            pending_press_ = true;
         }
         break;
     case DTupKeyEvent::RESERVED:
     default:
         TLOGW("got RESERVED event");
-        rc = ResponseCode::Aborted;
         state_ = InputState::None;
-        return result;
+        return ResponseCode::Aborted;
     }
     timestamps_[uint32_t(state_)] = now;
     TLOGD("%u", uint32_t(state_));
-    return result;
+    return ResponseCode::OK;
 }
 
 ResponseCode InputTracker::fetchInputEvent() {
@@ -198,8 +286,23 @@ ResponseCode InputTracker::fetchInputEvent() {
     }
 }
 
-ResponseCode InputTracker::reportVerifiedInput(InputEvent event) {
-    auto now = mtsNow();
+TimeStamp InputTracker::doubleClickDeadline() const {
+    if (!pending_press_) {
+        return 0;
+    }
+    return timestamps_[uint32_t(InputState::InputDeliveredMorePending)] +
+           kUserDoupleClickTimeoutMillis + 1;
+}
+
+void InputTracker::expirePendingInput(TimeStamp now) {
+    if (pending_press_ && now >= doubleClickDeadline()) {
+        TLOGD("double click window expired\n");
+        pending_press_ = false;
+    }
+}
+
+ResponseCode InputTracker::reportVerifiedInput(InputEvent event,
+                                               TimeStamp now) {
     if (state_ == InputState::Fresh &&
         (now - timestamps_[uint32_t(InputState::Fresh)]) >=
                 kUserPreInputGracePeriodMillis) {
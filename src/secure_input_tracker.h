@@ -18,10 +18,14 @@
 
 #include <secure_input/secure_input_proto.h>
 #include <stdint.h>
+#include "hmac_key_schedule.h"
+#include "nonce_pool.h"
 #include "trusty_time_stamper.h"
 
 #include <teeui/common_message_types.h>
 
+#include <vector>
+
 class InputTracker {
 public:
     enum class InputState : uint32_t {
@@ -41,37 +45,94 @@ public:
         UserConfirm,
     };
 
-    InputTracker() : state_(InputState::None), event_(InputEvent::None) {}
+    InputTracker()
+            : state_(InputState::None),
+              event_(InputEvent::None),
+              pending_press_(false) {}
+    /*
+     * All state transitions take the time at which the triggering message was
+     * dispatched, so that a single clock sample is used per message.
+     */
+
     // new Session
-    teeui::ResponseCode newSession();
+    teeui::ResponseCode newSession(monotonic_time_stamper::TimeStamp now);
+
+    // pre-generate handshake nonces off the critical path
+    bool fillNoncePool();
 
     // input Handshake
-    std::tuple<teeui::ResponseCode, secure_input::Nonce> beginHandshake();
+    std::tuple<teeui::ResponseCode, secure_input::Nonce> beginHandshake(
+            monotonic_time_stamper::TimeStamp now);
 
     // input Handshake fianlize
     teeui::ResponseCode finalizeHandshake(
             const secure_input::Nonce& nCi,
             const secure_input::Signature& signature,
-            const teeui::AuthTokenKey& key);
+            const HmacKeySchedule& hmac,
+            monotonic_time_stamper::TimeStamp now);
 
     // input event
     std::tuple<teeui::ResponseCode, secure_input::InputResponse>
     processInputEvent(secure_input::DTupKeyEvent keyEvent,
                       const secure_input::Signature& signature,
-                      const teeui::AuthTokenKey& key);
+                      const HmacKeySchedule& hmac,
+                      monotonic_time_stamper::TimeStamp now);
+
+    /*
+     * Batched input events: replays the events of a DeliverInputEventBatch
+     * payload in order, see secure_input_batch_proto.h. The whole batch is
+     * covered by one signature bound to the current nonce, so a first power
+     * button press within the batch does not require a new handshake before
+     * the next event. A batch whose events would date from before the
+     * handshake completed is rejected. Returns one InputResponse per event.
+     */
+    std::tuple<teeui::ResponseCode, std::vector<secure_input::InputResponse>>
+    processInputEventBatch(const teeui::MsgVector<uint8_t>& events,
+                           const secure_input::Signature& signature,
+                           const HmacKeySchedule& hmac,
+                           monotonic_time_stamper::TimeStamp now);
 
     // fetch result
     teeui::ResponseCode fetchInputEvent();
 
-    teeui::ResponseCode reportVerifiedInput(InputEvent event);
+    teeui::ResponseCode reportVerifiedInput(
+            InputEvent event,
+            monotonic_time_stamper::TimeStamp now);
+    /* Ends the session and wipes the nonces pooled for it. */
     void abort() {
         state_ = InputState::None;
         event_ = InputEvent::None;
+        pending_press_ = false;
+        nonce_pool_.clear();
     }
 
+    /*
+     * Returns the time at which the first press of a pending double click
+     * expires, or 0 if there is no pending press.
+     */
+    monotonic_time_stamper::TimeStamp doubleClickDeadline() const;
+
+    /*
+     * Drops a pending first press if its double click window has expired at
+     * the given time. This is the eager counterpart of the window check in
+     * processInputEvent.
+     */
+    void expirePendingInput(monotonic_time_stamper::TimeStamp now);
+
 private:
+    /*
+     * Applies a verified key event that happened at the given time. Expects
+     * state_ == HandshakeComplete.
+     */
+    teeui::ResponseCode applyKeyEvent(secure_input::DTupKeyEvent keyEvent,
+                                      monotonic_time_stamper::TimeStamp at,
+                                      secure_input::InputResponse* ir);
+
     InputState state_;
     InputEvent event_;
+    /* True while a first power button press waits for its second press. */
+    bool pending_press_;
     secure_input::Nonce input_nonce_;
+    NoncePool nonce_pool_;
     monotonic_time_stamper::TimeStamp timestamps_[uint32_t(InputState::Count)];
 };
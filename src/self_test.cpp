@@ -0,0 +1,250 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "self_test.h"
+
+#if CONFIRMATIONUI_SELF_TEST
+
+#include <string.h>
+
+#include <vector>
+
+#include <secure_input/secure_input_proto.h>
+#include <trusty_log.h>
+
+#include "hmac_key_schedule.h"
+#include "ipc.h"
+#include "secure_input_tracker.h"
+#include "trusty_operation.h"
+#include "trusty_time_stamper.h"
+
+#define TLOG_TAG "confirmationui"
+
+using teeui::ResponseCode;
+
+namespace selftest {
+
+namespace {
+
+const char kPrompt[] = "Confirm the payment of $1,234.56 to Example Merchant";
+
+const char* const kStepNames[] = {
+        "full render", "enable",    "fb fill",      "fb flip",
+        "hmac",        "handshake", "token finish", "cold handshake",
+};
+
+static_assert(sizeof(kStepNames) / sizeof(kStepNames[0]) ==
+                      CONFIRMATIONUI_SELF_TEST_STEP_COUNT,
+              "every self-test step needs a name");
+
+class Recorder {
+public:
+    explicit Recorder(confirmationui_self_test* report) : report_(report) {}
+
+    void add(confirmationui_self_test_step step, uint64_t us) {
+        auto& t = report_->steps[step];
+        uint32_t sample = us > UINT32_MAX ? UINT32_MAX : us;
+        if (!t.count || sample < t.min_us) {
+            t.min_us = sample;
+        }
+        if (sample > t.max_us) {
+            t.max_us = sample;
+        }
+        ++t.count;
+        t.total_us += us;
+    }
+
+    /* Times f() as one run of step. Returns the status of f(). */
+    template <typename F>
+    ResponseCode time(confirmationui_self_test_step step, const F& f) {
+        auto begin = monotonic_time_stamper::nowPrecise();
+        auto rc = f();
+        auto end = monotonic_time_stamper::nowPrecise();
+        if (rc == ResponseCode::OK) {
+            add(step, end - begin);
+        } else {
+            fail(step, rc);
+        }
+        return rc;
+    }
+
+    void fail(confirmationui_self_test_step step, ResponseCode rc) {
+        if (!report_->steps[step].status) {
+            report_->steps[step].status = uint32_t(rc);
+        }
+        if (!report_->status) {
+            report_->status = uint32_t(rc);
+        }
+    }
+
+private:
+    confirmationui_self_test* report_;
+};
+
+void runDisplaySteps(TrustyConfirmationUI* gui, Recorder* recorder,
+                     confirmationui_self_test* report) {
+    for (int i = 0; i < CONFIRMATIONUI_SELF_TEST_ITERATIONS; ++i) {
+        auto rc = recorder->time(CONFIRMATIONUI_SELF_TEST_FULL_RENDER, [&] {
+            return gui->start(kPrompt, "en", false, false);
+        });
+        if (rc != ResponseCode::OK) {
+            return;
+        }
+        rc = recorder->time(CONFIRMATIONUI_SELF_TEST_ENABLE,
+                            [&] { return gui->showInstructions(true); });
+        if (rc != ResponseCode::OK) {
+            return;
+        }
+        uint64_t fill_us;
+        uint64_t flip_us;
+        rc = gui->benchmarkFramebuffers(&fill_us, &flip_us, &report->fb_bytes);
+        if (rc != ResponseCode::OK) {
+            recorder->fail(CONFIRMATIONUI_SELF_TEST_FB_FILL, rc);
+            return;
+        }
+        recorder->add(CONFIRMATIONUI_SELF_TEST_FB_FILL, fill_us);
+        recorder->add(CONFIRMATIONUI_SELF_TEST_FB_FLIP, flip_us);
+        gui->blank();
+    }
+}
+
+/*
+ * Finishes a confirmation token whose message was absorbed ahead of time, the
+ * way TrustyOperation signs a confirmation, and checks that it matches the
+ * token computed in one go, the way teeui::Operation::signConfirmation does.
+ * Only the finish is timed.
+ */
+ResponseCode finishToken(const teeui::AuthTokenKey& key,
+                         const HmacKeySchedule& keys,
+                         const std::vector<uint8_t>& message,
+                         uint64_t* finish_us) {
+    PartialMac token;
+    if (!token.absorb(keys, HmacKeySchedule::Label::ConfirmationToken,
+                      {message})) {
+        return ResponseCode::SystemError;
+    }
+    auto begin = monotonic_time_stamper::nowPrecise();
+    auto prepared = token.finish();
+    auto end = monotonic_time_stamper::nowPrecise();
+    auto expected =
+            TrustyOperation::hmac256(key, {"confirmation token", message});
+    if (!prepared || !expected ||
+        memcmp(prepared->data(), expected->data(), expected->size())) {
+        TLOGE("self-test: prepared confirmation token of %zu bytes differs\n",
+              message.size());
+        return ResponseCode::SystemError;
+    }
+    *finish_us = end - begin;
+    return ResponseCode::OK;
+}
+
+void runMacSteps(Recorder* recorder) {
+    using namespace secure_input;
+    teeui::AuthTokenKey key;
+    memset(key.data(), 0xa5, key.size());
+    HmacKeySchedule keys;
+    if (!keys.prepare(key)) {
+        recorder->fail(CONFIRMATIONUI_SELF_TEST_HMAC,
+                       ResponseCode::SystemError);
+        return;
+    }
+    std::vector<uint8_t> message(CONFIRMATIONUI_MAX_MSG_SIZE, 0x5a);
+
+    /* Messages that end around the SHA-256 block and padding boundaries. */
+    uint64_t finish_us;
+    for (size_t size : {0, 1, 55, 56, 63, 64, 65, 119, 120, 128}) {
+        std::vector<uint8_t> prefix(message.begin(), message.begin() + size);
+        auto rc = finishToken(key, keys, prefix, &finish_us);
+        if (rc != ResponseCode::OK) {
+            recorder->fail(CONFIRMATIONUI_SELF_TEST_TOKEN_FINISH, rc);
+        }
+    }
+
+    InputTracker tracker;
+    Nonce nCi;
+    memset(nCi.data(), 0x3c, nCi.size());
+    /*
+     * Runs the TA side of a handshake in a session that started at 0, as if
+     * the grace period before input has passed. The client side is done in
+     * between.
+     */
+    auto handshake = [&] {
+        monotonic_time_stamper::TimeStamp now = kUserPreInputGracePeriodMillis;
+        auto [rc, nCo] = tracker.beginHandshake(now);
+        if (rc != ResponseCode::OK) {
+            return rc;
+        }
+        auto signature =
+                keys.mac(HmacKeySchedule::Label::Handshake, {nCo, nCi});
+        if (!signature) {
+            return ResponseCode::SystemError;
+        }
+        return tracker.finalizeHandshake(nCi, *signature, keys, now);
+    };
+    for (int i = 0; i < CONFIRMATIONUI_SELF_TEST_ITERATIONS; ++i) {
+        recorder->time(CONFIRMATIONUI_SELF_TEST_HMAC, [&] {
+            return TrustyOperation::hmac256(key, {"confirmation token",
+                                                  message})
+                           ? ResponseCode::OK
+                           : ResponseCode::SystemError;
+        });
+
+        auto rc = finishToken(key, keys, message, &finish_us);
+        if (rc == ResponseCode::OK) {
+            recorder->add(CONFIRMATIONUI_SELF_TEST_TOKEN_FINISH, finish_us);
+        } else {
+            recorder->fail(CONFIRMATIONUI_SELF_TEST_TOKEN_FINISH, rc);
+        }
+
+        /* With the nonce from the pool, then generated on demand. */
+        tracker.newSession(0);
+        tracker.fillNoncePool();
+        recorder->time(CONFIRMATIONUI_SELF_TEST_HANDSHAKE, handshake);
+        tracker.abort();
+        tracker.newSession(0);
+        recorder->time(CONFIRMATIONUI_SELF_TEST_HANDSHAKE_COLD, handshake);
+    }
+    tracker.abort();
+}
+
+}  // namespace
+
+ResponseCode run(TrustyConfirmationUI* gui, confirmationui_self_test* report) {
+    *report = {};
+    report->version = CONFIRMATIONUI_SELF_TEST_VERSION;
+    report->display_count = TrustyConfirmationUI::displayCount();
+    report->step_count = CONFIRMATIONUI_SELF_TEST_STEP_COUNT;
+
+    Recorder recorder(report);
+    runDisplaySteps(gui, &recorder, report);
+    gui->release();
+    runMacSteps(&recorder);
+
+    for (uint32_t i = 0; i < CONFIRMATIONUI_SELF_TEST_STEP_COUNT; ++i) {
+        auto& t = report->steps[i];
+        TLOGI("self-test %s: %u runs, min %u us, max %u us, avg %u us, "
+              "status %u\n",
+              kStepNames[i], t.count, t.min_us, t.max_us,
+              t.count ? uint32_t(t.total_us / t.count) : 0, t.status);
+    }
+    TLOGI("self-test: %llu framebuffer bytes per fill\n",
+          static_cast<unsigned long long>(report->fb_bytes));
+    return ResponseCode(report->status);
+}
+
+}  // namespace selftest
+
+#endif
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <teeui/msg_formatting.h>
+
+#include "telemetry_proto.h"
+#include "trusty_confirmation_ui.h"
+
+namespace selftest {
+
+/*
+ * Runs each step of the performance self-test
+ * CONFIRMATIONUI_SELF_TEST_ITERATIONS times and fills in report. The prompt
+ * is shown on the secure display and released again without user
+ * interaction. The MACs use a fixed test key and an input tracker of their
+ * own, so no session state is touched.
+ *
+ * Must not be called while a session shows a prompt, which start() would
+ * replace. Returns report->status.
+ */
+teeui::ResponseCode run(TrustyConfirmationUI* gui,
+                        confirmationui_self_test* report);
+
+}  // namespace selftest
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "session_telemetry.h"
+
+namespace telemetry {
+
+static confirmationui_telemetry stats = {
+        .version = CONFIRMATIONUI_TELEMETRY_VERSION,
+        .phase_count = CONFIRMATIONUI_PHASE_COUNT,
+        .counter_count = CONFIRMATIONUI_COUNTER_COUNT,
+        .startup =
+                {
+#if CONFIRMATIONUI_EAGER_INIT
+                        .eager_init = 1,
+#endif
+                        .step_count = CONFIRMATIONUI_STARTUP_STEP_COUNT,
+                        .milestone_count = CONFIRMATIONUI_MILESTONE_COUNT,
+                },
+};
+
+static monotonic_time_stamper::PreciseTimeStamp main_entry;
+/* Bit mask of the startup steps and milestones that were recorded. */
+static uint32_t steps_recorded;
+static uint32_t milestones_recorded;
+
+static uint32_t bucketOf(uint64_t sample) {
+    uint32_t bucket = 0;
+    while (sample && bucket < CONFIRMATIONUI_TELEMETRY_BUCKETS - 1) {
+        sample >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+void record(confirmationui_phase phase,
+            monotonic_time_stamper::PreciseTimeStamp begin,
+            bool ok) {
+    if (phase >= CONFIRMATIONUI_PHASE_COUNT || !begin.isOk() || !begin) {
+        return;
+    }
+    auto end = monotonic_time_stamper::nowPrecise();
+    if (!end.isOk() || end < begin) {
+        return;
+    }
+    uint64_t sample = end - begin;
+
+    auto& p = stats.phases[phase];
+    ++p.count;
+    if (!ok) {
+        ++p.failures;
+    }
+    p.total_us += sample;
+    if (sample > p.max_us) {
+        p.max_us = sample > UINT32_MAX ? UINT32_MAX : sample;
+    }
+    ++p.histogram[bucketOf(sample)];
+}
+
+void count(confirmationui_counter counter) {
+    if (counter < CONFIRMATIONUI_COUNTER_COUNT) {
+        ++stats.counters[counter];
+    }
+}
+
+void startMain() {
+    main_entry = monotonic_time_stamper::nowPrecise();
+}
+
+static uint32_t elapsedSince(monotonic_time_stamper::PreciseTimeStamp begin) {
+    auto end = monotonic_time_stamper::nowPrecise();
+    if (!begin.isOk() || !end.isOk() || end < begin) {
+        return 0;
+    }
+    uint64_t sample = end - begin;
+    return sample > UINT32_MAX ? UINT32_MAX : sample;
+}
+
+void recordStartup(confirmationui_startup_step step,
+                   monotonic_time_stamper::PreciseTimeStamp begin) {
+    if (step >= CONFIRMATIONUI_STARTUP_STEP_COUNT ||
+        (steps_recorded & (1u << step))) {
+        return;
+    }
+    steps_recorded |= 1u << step;
+    stats.startup.steps_us[step] = elapsedSince(begin);
+}
+
+void markMilestone(confirmationui_milestone milestone) {
+    if (milestone >= CONFIRMATIONUI_MILESTONE_COUNT ||
+        (milestones_recorded & (1u << milestone))) {
+        return;
+    }
+    milestones_recorded |= 1u << milestone;
+    stats.startup.milestones_us[milestone] = elapsedSince(main_entry);
+}
+
+const confirmationui_telemetry& snapshot() {
+    return stats;
+}
+
+}  // namespace telemetry
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "memory_stats.h"
+#include "telemetry_proto.h"
+#include "trusty_time_stamper.h"
+
+namespace telemetry {
+
+/*
+ * Records one sample for the given phase. The sample spans from begin until
+ * now. Samples with an invalid begin time stamp are dropped.
+ */
+void record(confirmationui_phase phase,
+            monotonic_time_stamper::PreciseTimeStamp begin,
+            bool ok = true);
+
+/*
+ * Increments the given event counter.
+ */
+void count(confirmationui_counter counter);
+
+/*
+ * Marks the entry of main(). Startup milestones are relative to it.
+ */
+void startMain();
+
+/*
+ * Records the duration of a startup step from begin until now. Only the first
+ * sample of each step is kept.
+ */
+void recordStartup(confirmationui_startup_step step,
+                   monotonic_time_stamper::PreciseTimeStamp begin);
+
+/*
+ * Records when a startup milestone was first reached.
+ */
+void markMilestone(confirmationui_milestone milestone);
+
+/*
+ * Returns the current counters. The telemetry is global to the TA, i.e., it
+ * accumulates over all channels and sessions since boot.
+ */
+const confirmationui_telemetry& snapshot();
+
+/*
+ * Times the scope it lives in and records it as a sample of the given phase
+ * when it goes out of scope. Also accounts the memory usage of the phase. See
+ * memory_stats.h.
+ */
+class PhaseTimer {
+public:
+    explicit PhaseTimer(confirmationui_phase phase)
+            : PhaseTimer(phase, monotonic_time_stamper::nowPrecise()) {}
+    /* Starts the phase at a clock sample the caller already took. */
+    PhaseTimer(confirmationui_phase phase,
+               monotonic_time_stamper::PreciseTimeStamp begin)
+            : phase_(phase), begin_(begin), ok_(true), memory_(phase) {}
+    ~PhaseTimer() { record(phase_, begin_, ok_); }
+
+    void fail() { ok_ = false; }
+    monotonic_time_stamper::PreciseTimeStamp begin() const { return begin_; }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    confirmationui_phase phase_;
+    monotonic_time_stamper::PreciseTimeStamp begin_;
+    bool ok_;
+    memory::Scope memory_;
+};
+
+}  // namespace telemetry
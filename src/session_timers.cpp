@@ -0,0 +1,103 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "session_timers.h"
+
+#include <trusty_ipc.h>
+
+using monotonic_time_stamper::TimeStamp;
+
+SessionTimers::SessionTimers() {
+    for (auto& slot : slots_) {
+        slot = {};
+    }
+}
+
+SessionTimers::Slot* SessionTimers::find(void* owner) {
+    for (auto& slot : slots_) {
+        if (slot.owner == owner) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+bool SessionTimers::arm(void* owner, Kind kind, TimeStamp deadline) {
+    if (!owner || kind >= Kind::Count) {
+        return false;
+    }
+    auto slot = find(owner);
+    if (!slot) {
+        if (!deadline) {
+            /* Nothing to cancel. */
+            return true;
+        }
+        slot = find(nullptr);
+        if (!slot) {
+            return false;
+        }
+        *slot = {};
+        slot->owner = owner;
+    }
+    slot->deadlines[uint32_t(kind)] = deadline;
+    return true;
+}
+
+void SessionTimers::cancel(void* owner) {
+    if (auto slot = find(owner)) {
+        *slot = {};
+    }
+}
+
+uint32_t SessionTimers::timeoutMillis(TimeStamp now) const {
+    uint64_t next = 0;
+    for (auto& slot : slots_) {
+        if (!slot.owner) {
+            continue;
+        }
+        for (auto deadline : slot.deadlines) {
+            if (deadline && (!next || deadline < next)) {
+                next = deadline;
+            }
+        }
+    }
+    if (!next) {
+        return INFINITE_TIME;
+    }
+    if (!now.isOk() || next <= now) {
+        return 0;
+    }
+    uint64_t timeout = next - now;
+    return timeout >= INFINITE_TIME ? INFINITE_TIME - 1 : timeout;
+}
+
+void SessionTimers::expire(TimeStamp now, Callback cb) {
+    if (!now.isOk() || !now) {
+        return;
+    }
+    for (auto& slot : slots_) {
+        for (uint32_t kind = 0; kind < uint32_t(Kind::Count); ++kind) {
+            /* The callback may cancel the slot. Check the owner every time. */
+            void* owner = slot.owner;
+            auto& deadline = slot.deadlines[kind];
+            if (!owner || !deadline || deadline > now) {
+                continue;
+            }
+            deadline = 0;
+            cb(owner, Kind(kind), now);
+        }
+    }
+}
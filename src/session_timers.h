@@ -0,0 +1,84 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "trusty_time_stamper.h"
+
+/*
+ * SessionTimers is a small fixed size timer wheel that holds the session and
+ * double click deadlines of all channels. The event loop uses it to compute
+ * how long it may wait for the next event and to fire expired deadlines.
+ *
+ * Deadlines are absolute monotonic_time_stamper time stamps. A deadline of 0
+ * means that the timer is not armed.
+ */
+class SessionTimers {
+public:
+    enum class Kind : uint32_t {
+        Session,
+        DoubleClick,
+        // insert new kinds above
+        Count,
+    };
+
+    /*
+     * The service accepts one channel at a time. Leave room for one more so
+     * that a new channel can be set up before the old one is cleaned up.
+     */
+    static constexpr const uint32_t kMaxOwners = 2;
+
+    using Callback = void (*)(void* owner,
+                              Kind kind,
+                              monotonic_time_stamper::TimeStamp now);
+
+    SessionTimers();
+
+    /*
+     * Arms, re-arms, or cancels (deadline == 0) the timer of the given kind
+     * for the given owner. Returns false if there is no free slot.
+     */
+    bool arm(void* owner,
+             Kind kind,
+             monotonic_time_stamper::TimeStamp deadline);
+
+    /* Cancels all timers of the given owner. */
+    void cancel(void* owner);
+
+    /*
+     * Returns the number of milliseconds until the next deadline or
+     * INFINITE_TIME if no timer is armed.
+     */
+    uint32_t timeoutMillis(monotonic_time_stamper::TimeStamp now) const;
+
+    /*
+     * Disarms all timers that expired at the given time and calls cb for each
+     * of them. The callback may re-arm timers.
+     */
+    void expire(monotonic_time_stamper::TimeStamp now, Callback cb);
+
+private:
+    struct Slot {
+        void* owner;
+        uint64_t deadlines[uint32_t(Kind::Count)];
+    };
+
+    Slot* find(void* owner);
+
+    Slot slots_[kMaxOwners];
+};
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sprite_cache.h"
+
+using teeui::Color;
+using teeui::Error;
+
+void Sprite::clear() {
+    runs_.clear();
+    runs_.shrink_to_fit();
+    recorded_ = false;
+    failed_ = false;
+}
+
+bool Sprite::append(uint32_t x, uint32_t y, Color color) {
+    if (x > UINT16_MAX || y > UINT16_MAX) {
+        return false;
+    }
+    if (!runs_.empty()) {
+        auto& last = runs_.back();
+        if (last.y == y && last.color == color &&
+            uint32_t(last.x) + last.length == x && last.length < UINT16_MAX) {
+            ++last.length;
+            return true;
+        }
+    }
+    if (runs_.size() >= kMaxRuns) {
+        return false;
+    }
+    runs_.push_back({uint16_t(x), uint16_t(y), 1, color});
+    return true;
+}
+
+Error Sprite::replay(const teeui::PixelDrawer& drawPixel) const {
+    for (const auto& run : runs_) {
+        for (uint32_t x = run.x; x < uint32_t(run.x) + run.length; ++x) {
+            if (auto error = drawPixel(x, run.y, run.color)) {
+                return error;
+            }
+        }
+    }
+    return Error::OK;
+}
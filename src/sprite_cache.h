@@ -0,0 +1,124 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <teeui/error.h>
+#include <teeui/utils.h>
+
+#include "element_index.h"
+
+/*
+ * Sprite is a run length encoded recording of the pixels an element draws.
+ * Consecutive pixels of one row with the same color form one run. Replaying
+ * a sprite issues exactly the same pixel draws as the element would, in the
+ * same order, without evaluating glyphs or shape coverage again.
+ */
+class Sprite {
+public:
+    /* Upper bound for the number of runs. Larger elements are not cached. */
+    static constexpr const size_t kMaxRuns = 4096;
+
+    bool isRecorded() const { return recorded_; }
+    /* True if recording failed. The element is then drawn directly. */
+    bool hasFailed() const { return failed_; }
+    void clear();
+
+    /*
+     * Records the pixels drawn by draw(drawPixel). Returns an error and leaves
+     * the sprite empty and failed if draw failed or the sprite got too large.
+     */
+    template <typename Draw>
+    teeui::Error record(const Draw& draw) {
+        using namespace teeui;
+        clear();
+        bool overflow = false;
+        auto error = draw(makePixelDrawer(
+                [&](uint32_t x, uint32_t y, Color color) -> Error {
+                    if (!append(x, y, color)) {
+                        overflow = true;
+                    }
+                    return Error::OK;
+                }));
+        if (error || overflow) {
+            clear();
+            failed_ = true;
+            return error ? error : Error(Error::OutOfMemory);
+        }
+        recorded_ = true;
+        return Error::OK;
+    }
+
+    teeui::Error replay(const teeui::PixelDrawer& drawPixel) const;
+
+private:
+    struct Run {
+        uint16_t x;
+        uint16_t y;
+        uint16_t length;
+        teeui::Color color;
+    };
+
+    bool append(uint32_t x, uint32_t y, teeui::Color color);
+
+    std::vector<Run> runs_;
+    bool recorded_ = false;
+    /* Set by a failed record() and reset by clear(). */
+    bool failed_ = false;
+};
+
+/*
+ * SpriteSet caches one Sprite for each of the given element types. Elements
+ * are recorded the first time they are drawn through the set. Other element
+ * types, and elements that cannot be recorded, are drawn directly. A failed
+ * recording is not retried until the sprite is cleared.
+ *
+ * A sprite is only valid for the geometry and color scheme it was recorded
+ * with, so a SpriteSet must be tied to exactly one instantiated layout
+ * configuration.
+ */
+template <typename... Elements>
+class SpriteSet {
+public:
+    /*
+     * Draws the element from its sprite. draw(drawPixel) draws the element
+     * directly and is used to record the sprite.
+     */
+    template <typename Element, typename Draw>
+    teeui::Error draw(const Element&,
+                      const teeui::PixelDrawer& drawPixel,
+                      const Draw& draw) {
+        constexpr size_t index = elementIndex<Element, Elements...>();
+        if constexpr (index == sizeof...(Elements)) {
+            return draw(drawPixel);
+        } else {
+            auto& sprite = sprites_[index];
+            if (sprite.hasFailed() ||
+                (!sprite.isRecorded() && sprite.record(draw))) {
+                return draw(drawPixel);
+            }
+            return sprite.replay(drawPixel);
+        }
+    }
+
+private:
+    Sprite sprites_[sizeof...(Elements)];
+};
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stripe_renderer.h"
+
+#if CONFIRMATIONUI_RENDER_THREADS > 1
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/*
+ * The worker threads of all StripeRenderers. They are started on first use
+ * and kept for the lifetime of the TA, so that channels do not start and join
+ * threads.
+ */
+class WorkerPool {
+public:
+    using Job = void (*)(void* ctx, uint32_t index);
+
+    WorkerPool();
+    ~WorkerPool();
+
+    /* Runs job(ctx, i) for every stripe i and waits for all of them. */
+    void run(Job job, void* ctx);
+
+private:
+    void work(uint32_t index);
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    /* The current job. Guarded by mutex_. */
+    Job job_;
+    void* ctx_;
+    /* Incremented for every job. Guarded by mutex_. */
+    uint64_t generation_;
+    /* Workers still running the current job. Guarded by mutex_. */
+    uint32_t pending_;
+    bool exit_;
+};
+
+WorkerPool::WorkerPool()
+        : job_(nullptr),
+          ctx_(nullptr),
+          generation_(0),
+          pending_(0),
+          exit_(false) {
+    /* The calling thread renders stripe 0. */
+    for (uint32_t i = 1; i < StripeRenderer::kStripes; ++i) {
+        workers_.emplace_back(&WorkerPool::work, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        exit_ = true;
+    }
+    start_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void WorkerPool::run(Job job, void* ctx) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = job;
+        ctx_ = ctx;
+        pending_ = workers_.size();
+        ++generation_;
+    }
+    start_.notify_all();
+    job(ctx, 0);
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return pending_ == 0; });
+    job_ = nullptr;
+    ctx_ = nullptr;
+}
+
+void WorkerPool::work(uint32_t index) {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        start_.wait(lock, [&] { return exit_ || generation_ != seen; });
+        if (exit_) {
+            return;
+        }
+        seen = generation_;
+        Job job = job_;
+        void* ctx = ctx_;
+        lock.unlock();
+        job(ctx, index);
+        lock.lock();
+        if (--pending_ == 0) {
+            done_.notify_one();
+        }
+    }
+}
+
+}  // namespace
+
+void StripeRenderer::run(Job job, void* ctx) {
+    static WorkerPool pool;
+    pool.run(job, ctx);
+}
+
+#else
+
+void StripeRenderer::run(Job job, void* ctx) {
+    job(ctx, 0);
+}
+
+#endif
+
+RenderTarget StripeRenderer::stripeOf(const RenderTarget& target,
+                                      uint32_t top,
+                                      uint32_t end,
+                                      teeui::Color bg) {
+    RenderTarget stripe = target;
+    size_t offset = size_t(top) * target.line_stride;
+    stripe.buffer += offset;
+    stripe.height = end - top;
+    size_t size = size_t(stripe.height) * target.line_stride;
+    stripe.size = offset >= target.size ? 0
+                  : size < target.size - offset ? size
+                                                : target.size - offset;
+    uint8_t* line = stripe.buffer;
+    for (uint32_t y = 0; y < stripe.height; ++y) {
+        uint8_t* pixel = line;
+        for (uint32_t x = 0; x < stripe.width; ++x) {
+            *reinterpret_cast<uint32_t*>(pixel) = bg;
+            pixel += stripe.pixel_stride;
+        }
+        line += stripe.line_stride;
+    }
+    return stripe;
+}
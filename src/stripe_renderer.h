@@ -0,0 +1,139 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <tuple>
+#include <utility>
+
+#include <teeui/error.h>
+#include <teeui/utils.h>
+
+#include "band_bins.h"
+#include "offscreen_frame.h"
+
+/*
+ * Number of stripes a frame is split into, and of threads rendering them,
+ * including the calling thread. Trusty apps are single threaded, so this
+ * must be 1 there. Platforms with std::thread may raise it.
+ */
+#ifndef CONFIRMATIONUI_RENDER_THREADS
+#define CONFIRMATIONUI_RENDER_THREADS 1
+#endif
+
+#if CONFIRMATIONUI_RENDER_THREADS < 1
+#error "CONFIRMATIONUI_RENDER_THREADS must be at least 1"
+#endif
+
+/*
+ * StripeRenderer renders a layout in CONFIRMATIONUI_RENDER_THREADS horizontal
+ * stripes of the target, one per thread, and returns once all of them are
+ * done.
+ *
+ * The elements are drawn once, in layout order, on the calling thread, and
+ * their pixels are sorted into the stripes by BandBins. The threads then
+ * clear their stripe and blend its pixels into it. Stripes are disjoint, so
+ * the threads never write the same pixel, and elements, fonts and sprites are
+ * only ever used by the calling thread. The threads thus split the blending
+ * and the memory traffic of the frame, while the rasterization of glyphs and
+ * shapes stays serial. With one thread, the stripe is the whole target and
+ * rendering happens on the calling thread.
+ *
+ * The worker threads are started with the first StripeRenderer and shared by
+ * all of them for the lifetime of the TA.
+ */
+class StripeRenderer {
+public:
+    static constexpr const uint32_t kStripes = CONFIRMATIONUI_RENDER_THREADS;
+
+    StripeRenderer() = default;
+
+    StripeRenderer(const StripeRenderer&) = delete;
+    StripeRenderer& operator=(const StripeRenderer&) = delete;
+
+    void release() { bins_.release(); }
+
+    /*
+     * Renders the layout into target. draw_element(element, drawPixel) draws a
+     * single element and is only called on the calling thread.
+     * make_drawer(stripe) must return a PixelDrawer that draws into the given
+     * stripe using stripe coordinates. It is called concurrently. Returns
+     * OutOfMemory if the pixels of the layout exceed
+     * CONFIRMATIONUI_BAND_BIN_RUNS, in which case nothing was drawn. Otherwise
+     * returns the first error of the topmost failing stripe.
+     */
+    template <typename... Elements, typename MakeDrawer, typename DrawElement>
+    teeui::Error render(std::tuple<Elements...>& layout,
+                        const RenderTarget& target,
+                        teeui::Color bg,
+                        const MakeDrawer& make_drawer,
+                        const DrawElement& draw_element) {
+        using namespace teeui;
+        using ErrorCode = decltype(std::declval<const Error&>().code());
+        uint32_t rows = (target.height + kStripes - 1) / kStripes;
+        if (!bins_.reset(rows, kStripes)) {
+            return Error::OutOfMemory;
+        }
+        auto bin = makePixelDrawer(
+                [&](uint32_t x, uint32_t y, Color color) -> Error {
+                    if (x >= target.width || y >= target.height) {
+                        return Error::OutOfBoundsDrawing;
+                    }
+                    return bins_.append(0, x, y, color);
+                });
+        Error error = Error::OK;
+        // Keep the first error but continue like drawElements.
+        ((error = error || draw_element(std::get<Elements>(layout), bin)),
+         ...);
+        if (error) {
+            return error;
+        }
+
+        ErrorCode errors[kStripes];
+        auto job = [&](uint32_t index) {
+            uint32_t top = index * rows < target.height ? index * rows
+                                                        : target.height;
+            uint32_t end = top + rows < target.height ? top + rows
+                                                      : target.height;
+            auto stripe = stripeOf(target, top, end, bg);
+            errors[index] = bins_.replay(index, make_drawer(stripe)).code();
+        };
+        run([](void* ctx, uint32_t index) {
+            (*static_cast<decltype(job)*>(ctx))(index);
+        }, &job);
+        for (auto code : errors) {
+            if (code != Error::OK) {
+                return code;
+            }
+        }
+        return Error::OK;
+    }
+
+private:
+    using Job = void (*)(void* ctx, uint32_t index);
+
+    /* Runs job(ctx, i) for every stripe i and waits for all of them. */
+    static void run(Job job, void* ctx);
+    /* Clears the rows [top, end) of target and returns them as a target. */
+    static RenderTarget stripeOf(const RenderTarget& target,
+                                 uint32_t top,
+                                 uint32_t end,
+                                 teeui::Color bg);
+
+    BandBins bins_;
+};
@@ -0,0 +1,490 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <teeui/common_message_types.h>
+#include <teeui/msg_formatting.h>
+
+/*
+ * This header is the only definition of the interface. The normal world tool
+ * in tools/replay includes it from here, and other clients must follow it.
+ *
+ * The telemetry protocol is an extended protocol (see
+ * teeui::Operation::extendedProtocolHook) that lets the normal world read
+ * session latency counters from the TA. It never carries prompt content.
+ */
+
+namespace telemetry {
+
+constexpr const teeui::Protocol kTelemetryProto = 2;
+
+enum class TelemetryCommand : uint32_t {
+    Invalid,
+    GetSessionStats,
+    RunRenderSweep,
+    GetMemoryStats,
+    RunSelfTest,
+};
+
+/*
+ * The response carries a struct confirmationui_telemetry (see below) in little
+ * endian byte order as an opaque byte vector. Clients must check the version
+ * field before interpreting the payload.
+ */
+using GetSessionStats =
+        teeui::Cmd<TelemetryCommand, TelemetryCommand::GetSessionStats>;
+using GetSessionStatsResponse =
+        teeui::Message<teeui::ResponseCode, teeui::MsgVector<uint8_t>>;
+
+/*
+ * Renders every combination of language, color scheme, font profile, sweep
+ * prompt and display offscreen and returns a struct confirmationui_sweep with
+ * the slowest configurations. Only TAs built with CONFIRMATIONUI_RENDER_SWEEP
+ * implement it. The TA does not serve other requests while the sweep runs.
+ */
+using RunRenderSweep =
+        teeui::Cmd<TelemetryCommand, TelemetryCommand::RunRenderSweep>;
+using RunRenderSweepResponse =
+        teeui::Message<teeui::ResponseCode, teeui::MsgVector<uint8_t>>;
+
+/*
+ * Returns a struct confirmationui_memory (see below) as an opaque byte
+ * vector. Only TAs built with CONFIRMATIONUI_MEMORY_STATS implement it.
+ */
+using GetMemoryStats =
+        teeui::Cmd<TelemetryCommand, TelemetryCommand::GetMemoryStats>;
+using GetMemoryStatsResponse =
+        teeui::Message<teeui::ResponseCode, teeui::MsgVector<uint8_t>>;
+
+/*
+ * Runs the performance self-test on the secure display and returns a struct
+ * confirmationui_self_test (see below) as an opaque byte vector. Only TAs
+ * built with CONFIRMATIONUI_SELF_TEST implement it. Returns
+ * ResponseCode::OperationPending while a prompt is shown.
+ */
+using RunSelfTest = teeui::Cmd<TelemetryCommand, TelemetryCommand::RunSelfTest>;
+using RunSelfTestResponse =
+        teeui::Message<teeui::ResponseCode, teeui::MsgVector<uint8_t>>;
+
+/*
+ * Test mode command that runs the same self-test through the test command
+ * path of the generic protocol. The response only carries the status. The
+ * timings and a one-line summary are written to the log. It is not an
+ * enumerator of teeui::TestModeCommands, so handlers check for it before
+ * switching over the enumerators. TAs built without CONFIRMATIONUI_SELF_TEST
+ * ignore it like any unknown test command.
+ */
+constexpr const teeui::TestModeCommands kRunSelfTest =
+        static_cast<teeui::TestModeCommands>(0x100);
+
+}  // namespace telemetry
+
+#define CONFIRMATIONUI_TELEMETRY_VERSION 8
+
+/**
+ * enum confirmationui_phase - phases of a confirmation session
+ * @CONFIRMATIONUI_PHASE_CONNECT:     channel connect including the auth token
+ *                                    key fetch
+ * @CONFIRMATIONUI_PHASE_INIT:        %CONFIRMATIONUI_CMD_INIT, i.e., mapping
+ *                                    the shared memory
+ * @CONFIRMATIONUI_PHASE_PROMPT:      parsing and formatting of the prompt
+ *                                    message
+ * @CONFIRMATIONUI_PHASE_RENDER:      TrustyConfirmationUI::start() until the
+ *                                    first frame was presented
+ * @CONFIRMATIONUI_PHASE_HANDSHAKE:   secure input handshake
+ * @CONFIRMATIONUI_PHASE_FINALIZE:    secure input handshake finalization
+ * @CONFIRMATIONUI_PHASE_INPUT_EVENT: delivery of an input event until the
+ *                                    confirmation token was signed
+ * @CONFIRMATIONUI_PHASE_TEARDOWN:    ending the session after abort or
+ *                                    finalize, i.e., blanking the UI
+ * @CONFIRMATIONUI_PHASE_RELEASE:     closing the secure framebuffers after the
+ *                                    response to the client was sent
+ * @CONFIRMATIONUI_PHASE_FIRST_FRAME: from the dispatch of
+ *                                    PromptUserConfirmation until something
+ *                                    is visible on all displays. With
+ *                                    CONFIRMATIONUI_PROGRESSIVE_FRAME, this is
+ *                                    the chrome without the prompt body.
+ * @CONFIRMATIONUI_PHASE_FULL_FRAME:  from the dispatch of
+ *                                    PromptUserConfirmation until the complete
+ *                                    prompt is visible on all displays
+ */
+enum confirmationui_phase : uint32_t {
+    CONFIRMATIONUI_PHASE_CONNECT,
+    CONFIRMATIONUI_PHASE_INIT,
+    CONFIRMATIONUI_PHASE_PROMPT,
+    CONFIRMATIONUI_PHASE_RENDER,
+    CONFIRMATIONUI_PHASE_HANDSHAKE,
+    CONFIRMATIONUI_PHASE_FINALIZE,
+    CONFIRMATIONUI_PHASE_INPUT_EVENT,
+    CONFIRMATIONUI_PHASE_TEARDOWN,
+    CONFIRMATIONUI_PHASE_RELEASE,
+    CONFIRMATIONUI_PHASE_FIRST_FRAME,
+    CONFIRMATIONUI_PHASE_FULL_FRAME,
+
+    CONFIRMATIONUI_PHASE_COUNT,
+};
+
+/*
+ * Latency histograms use logarithmic buckets. Bucket 0 counts samples of 0us,
+ * bucket i > 0 counts samples in the range [2^(i-1), 2^i)us. The last bucket
+ * also absorbs all samples that are larger.
+ */
+#define CONFIRMATIONUI_TELEMETRY_BUCKETS 24
+
+/**
+ * struct confirmationui_phase_stats - rolling counters for one session phase
+ * @count:     number of times the phase completed
+ * @failures:  number of times the phase completed with an error
+ * @total_us:  sum of all samples in microseconds
+ * @max_us:    largest sample in microseconds
+ * @histogram: latency histogram, see %CONFIRMATIONUI_TELEMETRY_BUCKETS
+ *
+ * All counters wrap around on overflow.
+ */
+struct __attribute__((__packed__)) confirmationui_phase_stats {
+    uint32_t count;
+    uint32_t failures;
+    uint64_t total_us;
+    uint32_t max_us;
+    uint32_t histogram[CONFIRMATIONUI_TELEMETRY_BUCKETS];
+};
+
+/**
+ * enum confirmationui_counter - event counters
+ * @CONFIRMATIONUI_COUNTER_NONCE_POOL_HIT:  handshake nonce taken from the
+ *                                          pre-generated pool
+ * @CONFIRMATIONUI_COUNTER_NONCE_POOL_MISS: handshake nonce generated
+ *                                          synchronously because the pool was
+ *                                          empty
+ * @CONFIRMATIONUI_COUNTER_PREWARM_REUSED:  the UI pre-warmed at
+ *                                          %CONFIRMATIONUI_CMD_INIT matched the
+ *                                          prompt and was used
+ * @CONFIRMATIONUI_COUNTER_PREWARM_DISCARDED: the UI pre-warmed at
+ *                                          %CONFIRMATIONUI_CMD_INIT did not
+ *                                          match the prompt and was thrown away
+ * @CONFIRMATIONUI_COUNTER_DEGRADED_SHAPES: a render was projected to miss
+ *                                          CONFIRMATIONUI_RENDER_BUDGET_US and
+ *                                          drew the remaining shapes without
+ *                                          anti-aliasing
+ * @CONFIRMATIONUI_COUNTER_DEGRADED_BLENDING: a render was still projected to
+ *                                          miss the budget and blended the
+ *                                          remaining elements with the
+ *                                          background color
+ */
+enum confirmationui_counter : uint32_t {
+    CONFIRMATIONUI_COUNTER_NONCE_POOL_HIT,
+    CONFIRMATIONUI_COUNTER_NONCE_POOL_MISS,
+    CONFIRMATIONUI_COUNTER_PREWARM_REUSED,
+    CONFIRMATIONUI_COUNTER_PREWARM_DISCARDED,
+    CONFIRMATIONUI_COUNTER_DEGRADED_SHAPES,
+    CONFIRMATIONUI_COUNTER_DEGRADED_BLENDING,
+
+    CONFIRMATIONUI_COUNTER_COUNT,
+};
+
+/**
+ * enum confirmationui_startup_step - steps of the cold start of the TA. Only
+ *                                    the first occurrence of each is timed.
+ * @CONFIRMATIONUI_STARTUP_HSET_CREATE:  tipc_hset_create()
+ * @CONFIRMATIONUI_STARTUP_ADD_SERVICE:  tipc_add_service()
+ * @CONFIRMATIONUI_STARTUP_WARM_UP:      eager initialization before the first
+ *                                       connection, see
+ *                                       CONFIRMATIONUI_EAGER_INIT
+ * @CONFIRMATIONUI_STARTUP_KEY_FETCH:    fetching the auth token key from
+ *                                       keymaster
+ * @CONFIRMATIONUI_STARTUP_FB_OPEN:      opening the secure framebuffers
+ * @CONFIRMATIONUI_STARTUP_FIRST_PROMPT: the first PromptUserConfirmation, from
+ *                                       dispatch until the prompt was
+ *                                       presented
+ */
+enum confirmationui_startup_step : uint32_t {
+    CONFIRMATIONUI_STARTUP_HSET_CREATE,
+    CONFIRMATIONUI_STARTUP_ADD_SERVICE,
+    CONFIRMATIONUI_STARTUP_WARM_UP,
+    CONFIRMATIONUI_STARTUP_KEY_FETCH,
+    CONFIRMATIONUI_STARTUP_FB_OPEN,
+    CONFIRMATIONUI_STARTUP_FIRST_PROMPT,
+
+    CONFIRMATIONUI_STARTUP_STEP_COUNT,
+};
+
+/**
+ * enum confirmationui_milestone - points of the cold start of the TA
+ * @CONFIRMATIONUI_MILESTONE_SERVICE_READY: the port accepts connections
+ * @CONFIRMATIONUI_MILESTONE_FIRST_CONNECT: the first channel is connected
+ * @CONFIRMATIONUI_MILESTONE_FIRST_FRAME:   the first prompt is presented
+ */
+enum confirmationui_milestone : uint32_t {
+    CONFIRMATIONUI_MILESTONE_SERVICE_READY,
+    CONFIRMATIONUI_MILESTONE_FIRST_CONNECT,
+    CONFIRMATIONUI_MILESTONE_FIRST_FRAME,
+
+    CONFIRMATIONUI_MILESTONE_COUNT,
+};
+
+/**
+ * struct confirmationui_startup - cold start profile
+ * @eager_init:      nonzero if the TA is built with CONFIRMATIONUI_EAGER_INIT
+ * @step_count:      number of entries in @steps_us
+ * @milestone_count: number of entries in @milestones_us
+ * @steps_us:        duration of each step indexed by
+ *                   enum confirmationui_startup_step, 0 if it did not happen
+ *                   yet
+ * @milestones_us:   time since main() was entered at which each milestone
+ *                   indexed by enum confirmationui_milestone was reached, 0 if
+ *                   it was not reached yet
+ */
+struct __attribute__((__packed__)) confirmationui_startup {
+    uint32_t eager_init;
+    uint32_t step_count;
+    uint32_t milestone_count;
+    uint32_t steps_us[CONFIRMATIONUI_STARTUP_STEP_COUNT];
+    uint32_t milestones_us[CONFIRMATIONUI_MILESTONE_COUNT];
+};
+
+/**
+ * struct confirmationui_telemetry - telemetry snapshot
+ * @version:       %CONFIRMATIONUI_TELEMETRY_VERSION
+ * @phase_count:   number of entries in @phases
+ * @counter_count: number of entries in @counters
+ * @phases:        per phase counters indexed by enum confirmationui_phase
+ * @counters:      event counters indexed by enum confirmationui_counter
+ * @startup:       cold start profile
+ */
+struct __attribute__((__packed__)) confirmationui_telemetry {
+    uint32_t version;
+    uint32_t phase_count;
+    uint32_t counter_count;
+    struct confirmationui_phase_stats phases[CONFIRMATIONUI_PHASE_COUNT];
+    uint32_t counters[CONFIRMATIONUI_COUNTER_COUNT];
+    struct confirmationui_startup startup;
+};
+
+#define CONFIRMATIONUI_SWEEP_VERSION 3
+
+/* Largest number of entries returned by %RunRenderSweep. */
+#define CONFIRMATIONUI_SWEEP_MAX_ENTRIES 128
+
+/**
+ * struct confirmationui_sweep_entry - one configuration of the render sweep
+ * @lang_id:     language, NUL terminated
+ * @inverted:    nonzero for the inverted color scheme
+ * @magnified:   nonzero for the magnified font profile
+ * @display:     index of the display
+ * @prompt:      index of the sweep prompt
+ * @width:       width of the display in pixels
+ * @height:      height of the display in pixels
+ * @status:      teeui::ResponseCode of the render
+ * @render_us:   time spent in TrustyConfirmationUI::renderOffscreen()
+ * @frame_bytes: size of the offscreen frame
+ * @checksum:    FNV-1a hash of the rendered frame, 0 if the render failed
+ * @heap_peak:   heap high-water mark during the render in bytes, 0 unless the
+ *               TA is built with CONFIRMATIONUI_MEMORY_STATS
+ * @direct_us:   @render_us with the render limited to the direct path
+ * @tiled_us:    @render_us with the render limited to the tiled path
+ *
+ * The times are wall-clock only. No cache-miss or bandwidth counters are
+ * available to the TA, and frames are rendered offscreen, not into the
+ * framebuffer.
+ */
+struct __attribute__((__packed__)) confirmationui_sweep_entry {
+    char lang_id[16];
+    uint8_t inverted;
+    uint8_t magnified;
+    uint8_t display;
+    uint8_t prompt;
+    uint32_t width;
+    uint32_t height;
+    uint32_t status;
+    uint32_t render_us;
+    uint32_t frame_bytes;
+    uint32_t checksum;
+    uint32_t heap_peak;
+    uint32_t direct_us;
+    uint32_t tiled_us;
+};
+
+/**
+ * struct confirmationui_sweep - result of %RunRenderSweep
+ * @version:     %CONFIRMATIONUI_SWEEP_VERSION
+ * @total:       number of configurations that were rendered
+ * @entry_count: number of entries that follow, at most
+ *               %CONFIRMATIONUI_SWEEP_MAX_ENTRIES
+ *
+ * The header is followed by the slowest configurations as
+ * struct confirmationui_sweep_entry, slowest first.
+ */
+struct __attribute__((__packed__)) confirmationui_sweep {
+    uint32_t version;
+    uint32_t total;
+    uint32_t entry_count;
+};
+
+#define CONFIRMATIONUI_MEMORY_VERSION 2
+
+/* Number of distinct commands whose memory usage is tracked. */
+#define CONFIRMATIONUI_MEMORY_COMMANDS 16
+
+/**
+ * struct confirmationui_memory_usage - memory usage of a phase or command
+ * @count:           number of times the phase or command ran
+ * @heap_peak:       highest heap usage while it ran, in bytes. This includes
+ *                   everything that was allocated before.
+ * @allocs_max:      largest number of allocations in one run
+ * @alloc_bytes_max: largest number of bytes allocated in one run
+ * @stack_peak:      deepest stack usage while it ran, in bytes below the frame
+ *                   of main()
+ */
+struct __attribute__((__packed__)) confirmationui_memory_usage {
+    uint32_t count;
+    uint32_t heap_peak;
+    uint32_t allocs_max;
+    uint32_t alloc_bytes_max;
+    uint32_t stack_peak;
+};
+
+/**
+ * struct confirmationui_command_memory - memory usage of one command
+ * @proto: protocol of the command
+ * @cmd:   command id
+ * @usage: memory usage
+ */
+struct __attribute__((__packed__)) confirmationui_command_memory {
+    uint32_t proto;
+    uint32_t cmd;
+    struct confirmationui_memory_usage usage;
+};
+
+/**
+ * struct confirmationui_memory - memory usage snapshot
+ * @version:       %CONFIRMATIONUI_MEMORY_VERSION
+ * @stack_bytes:   size of the stack the TA was built for
+ * @heap_live:     heap currently in use, in bytes
+ * @heap_peak:     heap high-water mark since boot, in bytes
+ * @allocs:        number of allocations since boot
+ * @alloc_bytes:   number of bytes allocated since boot
+ * @stack_peak:    deepest stack usage measured since boot, in bytes
+ * @phase_count:   number of entries in @phases
+ * @command_count: number of valid entries in @commands
+ * @phases:        usage per phase indexed by enum confirmationui_phase
+ * @commands:      usage per command in the order the commands were first seen
+ *
+ * Only allocations through the C++ allocation functions are accounted for.
+ * Sizes are the requested sizes without allocator overhead.
+ */
+struct __attribute__((__packed__)) confirmationui_memory {
+    uint32_t version;
+    uint32_t stack_bytes;
+    uint32_t heap_live;
+    uint32_t heap_peak;
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+    uint32_t stack_peak;
+    uint32_t phase_count;
+    uint32_t command_count;
+    struct confirmationui_memory_usage phases[CONFIRMATIONUI_PHASE_COUNT];
+    struct confirmationui_command_memory
+            commands[CONFIRMATIONUI_MEMORY_COMMANDS];
+};
+
+#define CONFIRMATIONUI_SELF_TEST_VERSION 3
+
+/* Number of times each step of the self-test is run. */
+#define CONFIRMATIONUI_SELF_TEST_ITERATIONS 8
+
+/**
+ * enum confirmationui_self_test_step - steps of the self-test
+ * @CONFIRMATIONUI_SELF_TEST_FULL_RENDER: TrustyConfirmationUI::start() with a
+ *                                        fixed prompt, i.e., opening the
+ *                                        framebuffers, rendering the full
+ *                                        frame and flipping it
+ * @CONFIRMATIONUI_SELF_TEST_ENABLE:      enabling the instructions after the
+ *                                        handshake, i.e., redrawing or
+ *                                        presenting the pre-rendered frame
+ * @CONFIRMATIONUI_SELF_TEST_FB_FILL:     writing every pixel of all
+ *                                        framebuffers
+ * @CONFIRMATIONUI_SELF_TEST_FB_FLIP:     flipping all framebuffers
+ * @CONFIRMATIONUI_SELF_TEST_HMAC:        the confirmation token MAC over a
+ *                                        message of CONFIRMATIONUI_MAX_MSG_SIZE
+ *                                        bytes
+ * @CONFIRMATIONUI_SELF_TEST_HANDSHAKE:   the TA side of the secure input
+ *                                        handshake, from the nonce to the
+ *                                        verified signature
+ * @CONFIRMATIONUI_SELF_TEST_TOKEN_FINISH: finishing a confirmation token
+ *                                        whose message was absorbed ahead of
+ *                                        time, which is all that is left when
+ *                                        the user confirms. Fails with
+ *                                        %SystemError if the token differs
+ *                                        from the one computed in one go
+ * @CONFIRMATIONUI_SELF_TEST_HANDSHAKE_COLD: same as
+ *                                        %CONFIRMATIONUI_SELF_TEST_HANDSHAKE
+ *                                        with an empty nonce pool, i.e., with
+ *                                        the nonce generated synchronously as
+ *                                        it was before the pool
+ */
+enum confirmationui_self_test_step : uint32_t {
+    CONFIRMATIONUI_SELF_TEST_FULL_RENDER,
+    CONFIRMATIONUI_SELF_TEST_ENABLE,
+    CONFIRMATIONUI_SELF_TEST_FB_FILL,
+    CONFIRMATIONUI_SELF_TEST_FB_FLIP,
+    CONFIRMATIONUI_SELF_TEST_HMAC,
+    CONFIRMATIONUI_SELF_TEST_HANDSHAKE,
+    CONFIRMATIONUI_SELF_TEST_TOKEN_FINISH,
+    CONFIRMATIONUI_SELF_TEST_HANDSHAKE_COLD,
+
+    CONFIRMATIONUI_SELF_TEST_STEP_COUNT,
+};
+
+/**
+ * struct confirmationui_self_test_timing - timing of one self-test step
+ * @status:   teeui::ResponseCode of the first failed run, 0 if all succeeded
+ * @count:    number of successful runs
+ * @min_us:   fastest run in microseconds
+ * @max_us:   slowest run in microseconds
+ * @total_us: sum of all successful runs in microseconds
+ */
+struct __attribute__((__packed__)) confirmationui_self_test_timing {
+    uint32_t status;
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+};
+
+/**
+ * struct confirmationui_self_test - result of %RunSelfTest
+ * @version:       %CONFIRMATIONUI_SELF_TEST_VERSION
+ * @status:        teeui::ResponseCode of the first failed step, 0 if all
+ *                 steps succeeded
+ * @display_count: number of displays
+ * @step_count:    number of entries in @steps
+ * @fb_bytes:      bytes written by one run of
+ *                 %CONFIRMATIONUI_SELF_TEST_FB_FILL
+ * @steps:         timing of each step indexed by
+ *                 enum confirmationui_self_test_step
+ */
+struct __attribute__((__packed__)) confirmationui_self_test {
+    uint32_t version;
+    uint32_t status;
+    uint32_t display_count;
+    uint32_t step_count;
+    uint64_t fb_bytes;
+    struct confirmationui_self_test_timing
+            steps[CONFIRMATIONUI_SELF_TEST_STEP_COUNT];
+};
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tiled_renderer.h"
+
+#include <string.h>
+
+bool TiledRenderer::allocate(uint32_t width) {
+    if (width == 0) {
+        return false;
+    }
+    uint32_t rows = CONFIRMATIONUI_TILE_BYTES / (width * sizeof(uint32_t));
+    return band_.allocate(width, rows ? rows : 1);
+}
+
+RenderTarget TiledRenderer::beginBand(uint32_t rows, teeui::Color bg) {
+    auto band = band_.target();
+    band.height = rows;
+    band.size = band.line_stride * rows;
+    auto pixels = reinterpret_cast<uint32_t*>(band.buffer);
+    for (size_t i = 0; i < size_t(band.width) * rows; ++i) {
+        pixels[i] = bg;
+    }
+    return band;
+}
+
+bool TiledRenderer::endBand(const RenderTarget& band,
+                            const RenderTarget& target,
+                            uint32_t top) {
+    if (band.pixel_stride != target.pixel_stride ||
+        band.line_stride > target.line_stride ||
+        size_t(target.line_stride) * (top + band.height - 1) +
+                        band.line_stride >
+                target.size) {
+        return false;
+    }
+    for (uint32_t y = 0; y < band.height; ++y) {
+        memcpy(target.buffer + size_t(top + y) * target.line_stride,
+               band.buffer + size_t(y) * band.line_stride, band.line_stride);
+    }
+    return true;
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+#include <array>
+#include <tuple>
+
+#include <teeui/error.h>
+#include <teeui/utils.h>
+
+#include "band_bins.h"
+#include "offscreen_frame.h"
+
+/*
+ * Size of one band of the tiled renderer in bytes. The band is cleared, drawn
+ * into, and written out while it is cache resident, so this should not exceed
+ * the data cache of the CPU the TA runs on.
+ */
+#ifndef CONFIRMATIONUI_TILE_BYTES
+#define CONFIRMATIONUI_TILE_BYTES (128 * 1024)
+#endif
+
+/* Vertical extent [top, bottom) of a layout element in pixels. */
+struct RowExtent {
+    uint32_t top;
+    uint32_t bottom;
+
+    bool intersects(uint32_t begin, uint32_t end) const {
+        return top < end && bottom > begin;
+    }
+};
+
+template <typename Layout>
+using RowExtents = std::array<RowExtent, std::tuple_size<Layout>::value>;
+
+template <typename Element, typename Context>
+RowExtent rowExtentOf(const Context& ctx) {
+    double top = (ctx = Element::pos_y).count();
+    double bottom = top + (ctx = Element::dim_h).count();
+    return {top > 0 ? uint32_t(floor(top)) : 0,
+            bottom > 0 ? uint32_t(ceil(bottom)) : 0};
+}
+
+/*
+ * Evaluates the vertical extent of every element of a layout in the given
+ * context. Elements never draw outside of their own bounds.
+ */
+template <typename... Elements, typename Context>
+RowExtents<std::tuple<Elements...>> computeRowExtents(
+        const std::tuple<Elements...>&,
+        const Context& ctx) {
+    return {rowExtentOf<Elements>(ctx)...};
+}
+
+/*
+ * TiledRenderer renders a layout in horizontal bands of
+ * CONFIRMATIONUI_TILE_BYTES. Each band is cleared, every element that
+ * intersects it is drawn into it, and the band is written to the target with
+ * one copy. The target memory is thus written once and never read, and the
+ * read-modify-write blending only touches the cache resident band.
+ *
+ * Every element is drawn once, in the first band it intersects. Its pixels in
+ * later bands are kept in BandBins and replayed when those bands are drawn,
+ * so tall elements such as the prompt body are not rasterized again per band.
+ */
+class TiledRenderer {
+public:
+    /*
+     * Ensures the band buffer fits targets of the given width. Returns false
+     * if the heap is exhausted.
+     */
+    bool allocate(uint32_t width);
+    void release() {
+        band_.release();
+        spill_.release();
+    }
+
+    /*
+     * Renders the layout into target. make_drawer(band) must return a
+     * PixelDrawer that draws into the given band using band coordinates.
+     * draw_element(element, drawPixel) draws a single element. Returns
+     * OutOfMemory if the pixels that spill into later bands exceed
+     * CONFIRMATIONUI_BAND_BIN_RUNS, in which case the target is incomplete.
+     */
+    template <typename... Elements, typename MakeDrawer, typename DrawElement>
+    teeui::Error render(std::tuple<Elements...>& layout,
+                        const RowExtents<std::tuple<Elements...>>& extents,
+                        const RenderTarget& target,
+                        teeui::Color bg,
+                        const MakeDrawer& make_drawer,
+                        const DrawElement& draw_element) {
+        using namespace teeui;
+        static_assert(sizeof...(Elements) <= UINT8_MAX,
+                      "element indices must fit BandBins");
+        if (!band_.isAllocated() || band_.target().width != target.width) {
+            return Error::OutOfMemory;
+        }
+        uint32_t rows = band_.target().height;
+        if (!spill_.reset(rows, (target.height + rows - 1) / rows)) {
+            return Error::OutOfMemory;
+        }
+        for (uint32_t top = 0; top < target.height; top += rows) {
+            uint32_t end = top + rows < target.height ? top + rows
+                                                      : target.height;
+            auto band = beginBand(end - top, bg);
+            auto draw_band = make_drawer(band);
+            uint32_t i = 0;
+            Error error = Error::OK;
+            // Draw in layout order so that blending matches the full screen
+            // path. Keep the first error but continue like drawElements.
+            ((error = error || drawInBand(std::get<Elements>(layout), i,
+                                          extents[i], target, top, end,
+                                          draw_band, draw_element),
+              ++i),
+             ...);
+            if (error) {
+                return error;
+            }
+            if (!endBand(band, target, top)) {
+                return Error::OutOfBoundsDrawing;
+            }
+        }
+        return Error::OK;
+    }
+
+private:
+    /*
+     * Draws element number index into the band [top, end) of target. The
+     * element is drawn in the first band it intersects, with the pixels below
+     * the band kept in spill_. In later bands, only those pixels are
+     * replayed.
+     */
+    template <typename Element, typename Drawer, typename DrawElement>
+    teeui::Error drawInBand(Element& element,
+                            uint32_t index,
+                            const RowExtent& extent,
+                            const RenderTarget& target,
+                            uint32_t top,
+                            uint32_t end,
+                            const Drawer& draw_band,
+                            const DrawElement& draw_element) {
+        using namespace teeui;
+        if (!extent.intersects(top, end)) {
+            return Error::OK;
+        }
+        if (extent.top < top) {
+            return spill_.replay(top / band_.target().height, index,
+                                 draw_band);
+        }
+        return draw_element(
+                element,
+                makePixelDrawer(
+                        [&](uint32_t x, uint32_t y, Color color) -> Error {
+                            if (x >= target.width || y >= target.height) {
+                                return Error::OutOfBoundsDrawing;
+                            }
+                            if (y >= end) {
+                                return spill_.append(index, x, y, color);
+                            }
+                            // Elements never draw above their extent.
+                            if (y < top) {
+                                return Error::OK;
+                            }
+                            return draw_band(x, y - top, color);
+                        }));
+    }
+
+    RenderTarget beginBand(uint32_t rows, teeui::Color bg);
+    bool endBand(const RenderTarget& band,
+                 const RenderTarget& target,
+                 uint32_t top);
+
+    OffscreenFrame band_;
+    BandBins spill_;
+};
@@ -20,6 +20,7 @@
 #include "trusty_operation.h"
 
 #include "device_parameters.h"
+#include "session_telemetry.h"
 
 #include <interface/secure_fb/secure_fb.h>
 #include <inttypes.h>
@@ -30,6 +31,9 @@
 #include <teeui/utils.h>
 #include <trusty_log.h>
 
+#include <algorithm>
+#include <type_traits>
+
 using teeui::ResponseCode;
 
 static constexpr const teeui::Color kColorEnabled = 0xff242120;
@@ -45,6 +49,12 @@ static constexpr const teeui::Color kColorHint = 0xff68635f;
 static constexpr const teeui::Color kColorButton = 0xffe8731a;
 static constexpr const teeui::Color kColorButtonInv = 0xfff69d66;
 
+#if CONFIRMATIONUI_TILED_RENDERING
+static constexpr const bool kTiledRendering = true;
+#else
+static constexpr const bool kTiledRendering = false;
+#endif
+
 template <typename Label, typename Layout>
 static teeui::Error updateString(Layout* layout) {
     using namespace teeui;
@@ -60,25 +70,109 @@ static teeui::Error updateString(Layout* layout) {
     return Error::OK;
 }
 
-template <typename Context>
-static void updateColorScheme(Context* ctx, bool inverted) {
+template <typename Layout>
+static teeui::Error updateTranslations(Layout* layout) {
     using namespace teeui;
+    if (auto error = updateString<LabelOK>(layout))
+        return error;
+    if (auto error = updateString<LabelCancel>(layout))
+        return error;
+    if (auto error = updateString<LabelTitle>(layout))
+        return error;
+    if (auto error = updateString<LabelHint>(layout))
+        return error;
+    return Error::OK;
+}
+
+static teeui::Color instructionColor(bool enabled, bool inverted) {
+    if (enabled) {
+        return inverted ? kColorEnabledInv : kColorEnabled;
+    } else {
+        return inverted ? kColorDisabledInv : kColorDisabled;
+    }
+}
+
+template <typename Layout>
+static void setInstructionColor(Layout* layout, teeui::Color color) {
+    using namespace teeui;
+    std::get<LabelOK>(*layout).setTextColor(color);
+    std::get<LabelCancel>(*layout).setTextColor(color);
+}
+
+static Palette schemePalette(bool inverted, bool enabled) {
+    Palette palette;
+    auto set = [&](PaletteSlot slot, teeui::Color color) {
+        palette[size_t(slot)] = color;
+    };
     if (inverted) {
-        ctx->template setParam<ShieldColor>(kColorShieldInv);
-        ctx->template setParam<ColorText>(kColorBackground);
-        ctx->template setParam<ColorBG>(kColorBackgroundInv);
-        ctx->template setParam<ColorButton>(kColorButtonInv);
-        ctx->template setParam<ColorButtonBG>(kColorEnabled);
-        ctx->template setParam<ColorTextHint>(kColorHintInv);
+        set(PaletteSlot::Background, kColorBackgroundInv);
+        set(PaletteSlot::Text, kColorBackground);
+        set(PaletteSlot::Hint, kColorHintInv);
+        set(PaletteSlot::Shield, kColorShieldInv);
+        set(PaletteSlot::Button, kColorButtonInv);
+        set(PaletteSlot::ButtonBackground, kColorEnabled);
     } else {
-        ctx->template setParam<ShieldColor>(kColorShield);
-        ctx->template setParam<ColorText>(kColorEnabled);
-        ctx->template setParam<ColorBG>(kColorBackground);
-        ctx->template setParam<ColorButton>(kColorButton);
-        ctx->template setParam<ColorButtonBG>(kColorBackground);
-        ctx->template setParam<ColorTextHint>(kColorHint);
+        set(PaletteSlot::Background, kColorBackground);
+        set(PaletteSlot::Text, kColorEnabled);
+        set(PaletteSlot::Hint, kColorHint);
+        set(PaletteSlot::Shield, kColorShield);
+        set(PaletteSlot::Button, kColorButton);
+        set(PaletteSlot::ButtonBackground, kColorBackground);
     }
-    return;
+    set(PaletteSlot::Instruction, instructionColor(enabled, inverted));
+    return palette;
+}
+
+static Palette sentinelPalette() {
+    Palette palette;
+    for (size_t i = 0; i < palette.size(); ++i) {
+        palette[i] = paletteSentinel(PaletteSlot(i));
+    }
+    return palette;
+}
+
+/*
+ * The colors a layout is instantiated with: one of the two color schemes, or
+ * palette sentinels for rendering into a PaletteFrame.
+ */
+enum class LayoutColors : uint32_t {
+    Regular,
+    Inverted,
+    Palette,
+    Count,
+};
+
+static LayoutColors layoutColors(bool inverted) {
+#if CONFIRMATIONUI_PALETTE_FRAME
+    (void)inverted;
+    return LayoutColors::Palette;
+#else
+    return inverted ? LayoutColors::Inverted : LayoutColors::Regular;
+#endif
+}
+
+static Palette layoutPalette(LayoutColors colors) {
+    switch (colors) {
+    case LayoutColors::Inverted:
+        return schemePalette(true, false);
+    case LayoutColors::Palette:
+        return sentinelPalette();
+    default:
+        return schemePalette(false, false);
+    }
+}
+
+template <typename Context>
+static void updateColorScheme(Context* ctx, const Palette& palette) {
+    using namespace teeui;
+    auto color = [&](PaletteSlot slot) { return palette[size_t(slot)]; };
+    ctx->template setParam<ShieldColor>(color(PaletteSlot::Shield));
+    ctx->template setParam<ColorText>(color(PaletteSlot::Text));
+    ctx->template setParam<ColorBG>(color(PaletteSlot::Background));
+    ctx->template setParam<ColorButton>(color(PaletteSlot::Button));
+    ctx->template setParam<ColorButtonBG>(
+            color(PaletteSlot::ButtonBackground));
+    ctx->template setParam<ColorTextHint>(color(PaletteSlot::Hint));
 }
 
 static teeui::Color alfaCombineChannel(uint32_t shift,
@@ -98,13 +192,199 @@ static teeui::Color alfaCombineChannel(uint32_t shift,
     return result << shift;
 }
 
+/*
+ * Draws one element through the render state of its display: button shapes
+ * with the scanline rasterizer if enabled, and from the cached sprite if the
+ * element has one.
+ */
+template <typename Element>
+static teeui::Error drawElement(Element& element,
+                                const teeui::PixelDrawer& drawPixel,
+                                const PanelState& panel) {
+    auto draw = [&](const teeui::PixelDrawer& draw_pixel) {
+#if CONFIRMATIONUI_SCANLINE_SHAPES
+        return panel.shapes.draw(element, draw_pixel);
+#else
+        return element.draw(draw_pixel);
+#endif
+    };
+    return panel.sprites ? panel.sprites->draw(element, drawPixel, draw)
+                         : draw(drawPixel);
+}
+
 template <typename... Elements>
 static teeui::Error drawElements(std::tuple<Elements...>& layout,
-                                 const teeui::PixelDrawer& drawPixel) {
+                                 const teeui::PixelDrawer& drawPixel,
+                                 const PanelState& panel) {
     // Error::operator|| is overloaded, so we don't get short circuit
     // evaluation. But we get the first error that occurs. We will still try and
     // draw the remaining elements in the order they appear in the layout tuple.
-    return (std::get<Elements>(layout).draw(drawPixel) || ...);
+    return (drawElement(std::get<Elements>(layout), drawPixel, panel) || ...);
+}
+
+/*
+ * Same as drawElements but leaves out the element Skip.
+ */
+template <typename Skip, typename... Elements>
+static teeui::Error drawElementsExcept(std::tuple<Elements...>& layout,
+                                       const teeui::PixelDrawer& drawPixel,
+                                       const PanelState& panel) {
+    return ((std::is_same<Elements, Skip>::value
+                     ? teeui::Error(teeui::Error::OK)
+                     : drawElement(std::get<Elements>(layout), drawPixel,
+                                   panel)) ||
+            ...);
+}
+
+/*
+ * Returns a PixelDrawer that blends into target. If palette is given, the
+ * drawn colors are palette sentinels that are resolved with it first.
+ */
+static auto makeBlendingDrawer(const RenderTarget& target,
+                               const Palette* palette) {
+    return teeui::makePixelDrawer([target, palette](uint32_t x, uint32_t y,
+                                                    teeui::Color color)
+                                          -> teeui::Error {
+        TLOGD("px %u %u: %08x", x, y, color);
+        size_t pos = y * target.line_stride + x * target.pixel_stride;
+        TLOGD("pos: %zu, bufferSize: %" PRIu32 "\n", pos, target.size);
+        if (pos >= target.size) {
+            return teeui::Error::OutOfBoundsDrawing;
+        }
+        if (palette) {
+            auto slot = size_t(sentinelSlot(color));
+            if (slot >= palette->size()) {
+                return teeui::Error::UnsupportedPixelFormat;
+            }
+            color = (color & 0xff000000) | ((*palette)[slot] & 0xffffff);
+        }
+        double alfa = (color & 0xff000000) >> 24;
+        alfa /= 255.0;
+        auto& pixel = *reinterpret_cast<teeui::Color*>(target.buffer + pos);
+
+        pixel = alfaCombineChannel(0, alfa, color, pixel) |
+                alfaCombineChannel(8, alfa, color, pixel) |
+                alfaCombineChannel(16, alfa, color, pixel);
+        return teeui::Error::OK;
+    });
+}
+
+#if CONFIRMATIONUI_RENDER_BUDGET_US
+/*
+ * Returns a PixelDrawer like makeBlendingDrawer that blends with the solid
+ * background color instead of the pixel in target, so target is only written.
+ */
+static auto makeBackgroundDrawer(const RenderTarget& target,
+                                 const Palette* palette,
+                                 teeui::Color background) {
+    return teeui::makePixelDrawer([target, palette, background](
+                                          uint32_t x, uint32_t y,
+                                          teeui::Color color) -> teeui::Error {
+        size_t pos = y * target.line_stride + x * target.pixel_stride;
+        if (pos >= target.size) {
+            return teeui::Error::OutOfBoundsDrawing;
+        }
+        if (palette) {
+            auto slot = size_t(sentinelSlot(color));
+            if (slot >= palette->size()) {
+                return teeui::Error::UnsupportedPixelFormat;
+            }
+            color = (color & 0xff000000) | ((*palette)[slot] & 0xffffff);
+        }
+        double alfa = (color & 0xff000000) >> 24;
+        alfa /= 255.0;
+        *reinterpret_cast<teeui::Color*>(target.buffer + pos) =
+                alfaCombineChannel(0, alfa, color, background) |
+                alfaCombineChannel(8, alfa, color, background) |
+                alfaCombineChannel(16, alfa, color, background);
+        return teeui::Error::OK;
+    });
+}
+
+/*
+ * Returns a PixelDrawer that removes anti-aliasing: pixels that are at least
+ * half covered are drawn opaque with drawPixel, the others are dropped.
+ */
+template <typename Drawer>
+static auto makeAliasedDrawer(Drawer drawPixel) {
+    return teeui::makePixelDrawer(
+            [drawPixel](uint32_t x, uint32_t y,
+                        teeui::Color color) -> teeui::Error {
+                if ((color >> 24) < 0x80) {
+                    return teeui::Error::OK;
+                }
+                return drawPixel(x, y, color | 0xff000000);
+            });
+}
+
+/*
+ * Draws the element at position index of the layout with the quality budget
+ * picks for it. Button shapes lose their anti-aliasing first, then all
+ * elements are blended with the background color.
+ */
+template <typename Element>
+static teeui::Error drawElementWithin(Element& element,
+                                      size_t index,
+                                      LayoutBudget* budget,
+                                      const teeui::PixelDrawer& blending,
+                                      const teeui::PixelDrawer& background,
+                                      const teeui::PixelDrawer& aliased,
+                                      const PanelState& panel) {
+    auto quality = budget->beforeElement(index);
+    auto drawPixel = &blending;
+    if (quality != RenderQuality::Full && IconShapes::holds<Element>()) {
+        drawPixel = &aliased;
+    } else if (quality == RenderQuality::SolidBackground) {
+        drawPixel = &background;
+    }
+    auto error = drawElement(element, *drawPixel, panel);
+    budget->afterElement(index, quality);
+    return error;
+}
+
+/*
+ * Same as drawElements into a target that was cleared to bgColor, but
+ * degrades the quality as budget projects the render to take too long.
+ */
+template <typename... Elements>
+static teeui::Error drawElementsWithin(std::tuple<Elements...>& layout,
+                                       LayoutBudget* budget,
+                                       const RenderTarget& target,
+                                       const Palette* palette,
+                                       teeui::Color bgColor,
+                                       const PanelState& panel) {
+    auto blending = makeBlendingDrawer(target, palette);
+    auto background = makeBackgroundDrawer(target, palette, bgColor);
+    auto aliased = makeAliasedDrawer(background);
+    budget->begin();
+    return (drawElementWithin(std::get<Elements>(layout),
+                              elementIndex<Elements, Elements...>(), budget,
+                              blending, background, aliased, panel) ||
+            ...);
+}
+#endif
+
+static auto makePaletteDrawer(PaletteFrame* frame) {
+    return teeui::makePixelDrawer(
+            [frame](uint32_t x, uint32_t y, teeui::Color color) {
+                return frame->drawPixel(x, y, color);
+            });
+}
+
+static void clearTarget(const RenderTarget& target, teeui::Color bgColor) {
+    uint8_t* line_iter = target.buffer;
+    for (uint32_t yi = 0; yi < target.height; ++yi) {
+        auto pixel_iter = line_iter;
+        for (uint32_t xi = 0; xi < target.width; ++xi) {
+            *reinterpret_cast<uint32_t*>(pixel_iter) = bgColor;
+            pixel_iter += target.pixel_stride;
+        }
+        line_iter += target.line_stride;
+    }
+}
+
+static teeui::Color backgroundColor(bool inverted) {
+    return inverted ? kColorBackgroundInv : kColorBackground;
 }
 
 static ResponseCode teeuiError2ResponseCode(const teeui::Error& e) {
@@ -138,41 +418,219 @@ static ResponseCode teeuiError2ResponseCode(const teeui::Error& e) {
     }
 }
 
-teeui::Error TrustyConfirmationUI::updateTranslations(uint32_t idx) {
+/*
+ * Devices that know their display parameters at build time override this
+ * with a table of static profiles. See device_parameters.h.
+ */
+__attribute__((weak)) devices::StaticDisplayProfiles
+devices::getStaticDisplayProfiles() {
+    return {nullptr, nullptr, 0};
+}
+
+using ConfUILayout_t = teeui::layout_t<teeui::ConfUILayout>;
+
+struct PanelLayouts {
+    std::vector<ConfUILayout_t> layouts;
+    std::vector<PanelState> panels;
+};
+
+static void addPanelLayout(PanelLayouts* out,
+                           teeui::context<teeui::ConUIParameters>* ctx,
+                           LayoutColors colors) {
     using namespace teeui;
-    if (auto error = updateString<LabelOK>(&layout_[idx]))
-        return error;
-    if (auto error = updateString<LabelCancel>(&layout_[idx]))
-        return error;
-    if (auto error = updateString<LabelTitle>(&layout_[idx]))
-        return error;
-    if (auto error = updateString<LabelHint>(&layout_[idx]))
-        return error;
-    return Error::OK;
+    updateColorScheme(ctx, layoutPalette(colors));
+    out->layouts.push_back(instantiateLayout(ConfUILayout(), *ctx));
+    out->panels.push_back(
+            {uint32_t((*ctx->getParam<RightEdgeOfScreen>()).count()),
+             uint32_t((*ctx->getParam<BottomOfScreen>()).count()),
+             computeRowExtents(out->layouts.back(), *ctx),
+#if CONFIRMATIONUI_SCANLINE_SHAPES
+             IconShapes::of(*ctx),
+#else
+             IconShapes(),
+#endif
+             nullptr});
+}
+
+/*
+ * Instantiates the layouts of all displays for the given font profile and
+ * colors. With static display profiles the geometry never changes, so each
+ * combination is evaluated once and copied from then on.
+ * The icons of these layouts are also cached as sprites after they are drawn
+ * for the first time. Otherwise the device context is resolved at runtime on
+ * every call and the icons are always rasterized.
+ */
+static PanelLayouts instantiateLayouts(bool magnified, LayoutColors colors) {
+    static PanelLayouts cache[2][uint32_t(LayoutColors::Count)];
+
+    auto profiles = devices::getStaticDisplayProfiles();
+    if (profiles.count == 0) {
+        PanelLayouts result;
+        for (auto& ctx : devices::getDeviceContext(magnified)) {
+            addPanelLayout(&result, &ctx, colors);
+        }
+        return result;
+    }
+
+    auto& cached = cache[magnified][uint32_t(colors)];
+    if (cached.layouts.empty()) {
+        auto table = magnified ? profiles.magnified : profiles.regular;
+        for (size_t i = 0; i < profiles.count; ++i) {
+            auto ctx = table[i].toContext();
+            addPanelLayout(&cached, &ctx, colors);
+            cached.panels.back().sprites = std::make_shared<IconSprites>();
+        }
+    }
+    return cached;
+}
+
+bool TrustyConfirmationUI::Profile::set(const char* lang,
+                                        bool inv,
+                                        bool mag) {
+    size_t len = strlen(lang);
+    if (len >= kMaxLangIdSize) {
+        return false;
+    }
+    memcpy(lang_id, lang, len + 1);
+    inverted = inv;
+    magnified = mag;
+    return true;
+}
+
+bool TrustyConfirmationUI::Profile::operator==(const Profile& other) const {
+    return inverted == other.inverted && magnified == other.magnified &&
+           !strcmp(lang_id, other.lang_id);
+}
+
+TrustyConfirmationUI::Profile TrustyConfirmationUI::last_profile_ = {
+        "en", false, false};
+
+std::vector<OffscreenFrame> TrustyConfirmationUI::composition_;
+std::vector<TrustyConfirmationUI::ProfileBudget> TrustyConfirmationUI::budgets_;
+
+void TrustyConfirmationUI::prewarm() {
+    using namespace teeui;
+
+    discardPrewarm();
+#if CONFIRMATIONUI_PALETTE_FRAME
+    /* Pre-warmed frames hold RGBA pixels, which the palette path cannot use. */
+    return;
+#endif
+    auto panels = instantiateLayouts(
+            last_profile_.magnified, layoutColors(last_profile_.inverted));
+    auto deviceCount = panels.layouts.size();
+    if (deviceCount < 1) {
+        return;
+    }
+
+    prewarm_layout_ = std::move(panels.layouts);
+    prewarm_panels_ = std::move(panels.panels);
+    chrome_.resize(deviceCount);
+    localization::selectLangId(last_profile_.lang_id);
+    for (auto i = 0; i < (int)deviceCount; ++i) {
+        if (updateTranslations(&prewarm_layout_[i])) {
+            discardPrewarm();
+            return;
+        }
+        setInstructionColor(&prewarm_layout_[i],
+                            instructionColor(false, last_profile_.inverted));
+
+        if (!chrome_[i].allocate(prewarm_panels_[i].width,
+                                 prewarm_panels_[i].height)) {
+            TLOGW("Not enough memory to pre-warm the UI\n");
+            discardPrewarm();
+            return;
+        }
+        auto target = chrome_[i].target();
+        clearTarget(target, backgroundColor(last_profile_.inverted));
+        if (auto error = drawElementsExcept<LabelBody>(
+                    prewarm_layout_[i], makeBlendingDrawer(target, nullptr),
+                    prewarm_panels_[i])) {
+            TLOGE("Pre-warm drawing failed: %u\n", error.code());
+            discardPrewarm();
+            return;
+        }
+    }
+    prewarm_profile_ = last_profile_;
+    prewarmed_ = true;
+}
+
+void TrustyConfirmationUI::discardPrewarm() {
+    prewarmed_ = false;
+    prewarm_layout_.clear();
+    prewarm_panels_.clear();
+    chrome_.clear();
+}
+
+bool TrustyConfirmationUI::takePrewarmed(const Profile& profile) {
+    if (!prewarmed_) {
+        return false;
+    }
+    if (!(prewarm_profile_ == profile)) {
+        TLOGI("Discarding pre-warmed UI\n");
+        telemetry::count(CONFIRMATIONUI_COUNTER_PREWARM_DISCARDED);
+        discardPrewarm();
+        return false;
+    }
+    TLOGI("Reusing pre-warmed UI\n");
+    telemetry::count(CONFIRMATIONUI_COUNTER_PREWARM_REUSED);
+    layout_ = std::move(prewarm_layout_);
+    panels_ = std::move(prewarm_panels_);
+    prewarm_layout_.clear();
+    prewarm_panels_.clear();
+    return true;
 }
 
-ResponseCode TrustyConfirmationUI::start(const char* prompt,
-                                         const char* lang_id,
-                                         bool inverted,
-                                         bool magnified) {
+ResponseCode TrustyConfirmationUI::start(
+        const char* prompt,
+        const char* lang_id,
+        bool inverted,
+        bool magnified,
+        monotonic_time_stamper::PreciseTimeStamp begin) {
     ResponseCode render_error = ResponseCode::OK;
-    enabled_ = true;
+    enabled_ = false;
+    enabled_frame_ready_ = false;
     inverted_ = inverted;
 
     using namespace teeui;
 
-    auto ctx = devices::getDeviceContext(magnified);
-    auto deviceCount = ctx.size();
+    known_profile_ = profile_.set(lang_id, inverted, magnified);
+    bool reuse = known_profile_ && takePrewarmed(profile_);
+    if (!reuse) {
+        discardPrewarm();
+    }
+    if (known_profile_) {
+        last_profile_ = profile_;
+    }
+
+    PanelLayouts panels;
+    size_t deviceCount;
+    if (reuse) {
+        deviceCount = layout_.size();
+    } else {
+        panels = instantiateLayouts(magnified, layoutColors(inverted));
+        deviceCount = panels.layouts.size();
+    }
 
     if (deviceCount < 1) {
         TLOGE("Invalud deviceCount:  %d\n", (int)deviceCount);
         return ResponseCode::UIError;
     }
 
+    /* A previous session may not have been released yet. */
+    closeFramebuffers();
     fb_info_.resize(deviceCount);
     secure_fb_handle_.resize(deviceCount);
+    front_buffers_.assign(deviceCount, nullptr);
+#if CONFIRMATIONUI_PALETTE_FRAME
+    palette_frames_.resize(deviceCount);
+#endif
     layout_.resize(deviceCount);
+    if (!reuse) {
+        panels_ = std::move(panels.panels);
+    }
 
+    auto fb_begin = monotonic_time_stamper::nowPrecise();
     for (auto i = 0; i < (int)deviceCount; ++i) {
         if (auto rc = secure_fb_open(&secure_fb_handle_[i], &fb_info_[i], i)) {
             TLOGE("secure_fb_open returned  %d\n", rc);
@@ -185,82 +643,404 @@ ResponseCode TrustyConfirmationUI::start(const char* prompt,
             return ResponseCode::UIError;
         }
 
-        if (*(ctx[i]).getParam<RightEdgeOfScreen>() != pxs(fb_info_[i].width) ||
-            *(ctx[i]).getParam<BottomOfScreen>() != pxs(fb_info_[i].height)) {
+        if (panels_[i].width != fb_info_[i].width ||
+            panels_[i].height != fb_info_[i].height) {
             TLOGE("Framebuffer dimensions do not match panel configuration\n");
             TLOGE("Check device configuration\n");
             stop();
             return ResponseCode::UIError;
         }
     }
+    telemetry::recordStartup(CONFIRMATIONUI_STARTUP_FB_OPEN, fb_begin);
 
+    if (!reuse) {
+        localization::selectLangId(lang_id);
+    }
+    /*
+     * The palette path keeps no RGBA chrome to flip twice. Without the heap
+     * for the chrome frames, the prompt is presented in one flip.
+     */
+    bool progressive = false;
+#if CONFIRMATIONUI_PROGRESSIVE_FRAME && !CONFIRMATIONUI_PALETTE_FRAME
+    progressive = reuse || allocateChrome();
+#endif
     for (auto i = 0; i < (int)deviceCount; ++i) {
-        updateColorScheme(&(ctx[i]), inverted_);
-        layout_[i] = instantiateLayout(ConfUILayout(), ctx[i]);
+        if (!reuse) {
+            layout_[i] = std::move(panels.layouts[i]);
 
-        localization::selectLangId(lang_id);
-        if (auto error = updateTranslations(i)) {
-            stop();
-            return teeuiError2ResponseCode(error);
+            if (auto error = updateTranslations(&layout_[i])) {
+                stop();
+                return teeuiError2ResponseCode(error);
+            }
+            setInstructionColor(&layout_[i], layoutInstructionColor());
         }
 
         std::get<LabelBody>(layout_[i])
                 .setText({prompt, prompt + strlen(prompt)});
 
-        showInstructions(false /* enable */);
-        render_error = renderAndSwap(i);
+        if (progressive) {
+            render_error = presentChrome(i, !reuse);
+            if (render_error != ResponseCode::OK) {
+                stop();
+                return render_error;
+            }
+        }
+    }
+    if (progressive) {
+        telemetry::record(CONFIRMATIONUI_PHASE_FIRST_FRAME, begin);
+    }
+    for (auto i = 0; i < (int)deviceCount; ++i) {
+        render_error = reuse || progressive ? renderBodyAndSwap(i)
+                                            : renderAndSwap(i);
         if (render_error != ResponseCode::OK) {
             stop();
             return render_error;
         }
     }
+    if (!progressive) {
+        telemetry::record(CONFIRMATIONUI_PHASE_FIRST_FRAME, begin);
+    }
+    telemetry::record(CONFIRMATIONUI_PHASE_FULL_FRAME, begin);
+    discardPrewarm();
+    active_ = true;
+    telemetry::markMilestone(CONFIRMATIONUI_MILESTONE_FIRST_FRAME);
+    prerenderEnabled();
+    return ResponseCode::OK;
+}
+
+ResponseCode TrustyConfirmationUI::renderOffscreen(const char* prompt,
+                                                   const char* lang_id,
+                                                   bool inverted,
+                                                   bool magnified,
+                                                   uint32_t display,
+                                                   OffscreenFrame* frame,
+                                                   RenderPath path) {
+    using namespace teeui;
+    if (active_) {
+        return ResponseCode::OperationPending;
+    }
+    discardPrewarm();
+    enabled_ = false;
+    enabled_frame_ready_ = false;
+    inverted_ = inverted;
+
+    auto panels = instantiateLayouts(magnified, layoutColors(inverted));
+    if (display >= panels.layouts.size()) {
+        return ResponseCode::UIError;
+    }
+    auto& panel = panels.panels[display];
+    if (!frame->allocate(panel.width, panel.height)) {
+        return ResponseCode::SystemError;
+    }
+
+    /* The display is rendered as display 0. */
+    layout_.clear();
+    layout_.push_back(std::move(panels.layouts[display]));
+    panels_.assign(1, std::move(panel));
+#if CONFIRMATIONUI_PALETTE_FRAME
+    palette_frames_.resize(1);
+#endif
+
+    localization::selectLangId(lang_id);
+    if (auto error = updateTranslations(&layout_[0])) {
+        return teeuiError2ResponseCode(error);
+    }
+    setInstructionColor(&layout_[0], layoutInstructionColor());
+    std::get<LabelBody>(layout_[0]).setText({prompt, prompt + strlen(prompt)});
+    render_path_ = path;
+    auto rc = render(0, frame->target());
+    render_path_ = RenderPath::Default;
+    return rc;
+}
+
+void TrustyConfirmationUI::warmUp() {
+    using namespace teeui;
+    auto panels = instantiateLayouts(last_profile_.magnified,
+                                     layoutColors(last_profile_.inverted));
+    auto discard = makePixelDrawer(
+            [](uint32_t, uint32_t, Color) -> Error { return Error::OK; });
+    localization::selectLangId(last_profile_.lang_id);
+    for (size_t i = 0; i < panels.layouts.size(); ++i) {
+        if (updateTranslations(&panels.layouts[i])) {
+            return;
+        }
+        if (auto error = drawElementsExcept<LabelBody>(
+                    panels.layouts[i], discard, panels.panels[i])) {
+            TLOGW("Warm-up drawing failed: %u\n", error.code());
+            return;
+        }
+    }
+}
+
+ResponseCode TrustyConfirmationUI::benchmarkFramebuffers(uint64_t* fill_us,
+                                                         uint64_t* flip_us,
+                                                         uint64_t* bytes) {
+    using monotonic_time_stamper::nowPrecise;
+    if (!active_) {
+        return ResponseCode::UIError;
+    }
+    *fill_us = 0;
+    *flip_us = 0;
+    *bytes = 0;
+    /* The back buffers are overwritten. */
+    enabled_frame_ready_ = false;
+    for (auto i = 0; i < (int)fb_info_.size(); ++i) {
+        auto target = RenderTarget::fromSecureFb(fb_info_[i]);
+        auto begin = nowPrecise();
+        clearTarget(target, backgroundColor(inverted_));
+        auto filled = nowPrecise();
+        auto rc = present(i);
+        auto end = nowPrecise();
+        if (rc != ResponseCode::OK) {
+            stop();
+            return rc;
+        }
+        *fill_us += filled - begin;
+        *flip_us += end - filled;
+        *bytes += uint64_t(target.height) * target.line_stride;
+    }
     return ResponseCode::OK;
 }
 
+size_t TrustyConfirmationUI::displayCount() {
+    return instantiateLayouts(false, layoutColors(false)).layouts.size();
+}
+
 ResponseCode TrustyConfirmationUI::renderAndSwap(uint32_t idx) {
+    auto rc = render(idx);
+    if (rc != ResponseCode::OK) {
+        return rc;
+    }
+    return present(idx);
+}
+
+ResponseCode TrustyConfirmationUI::render(uint32_t idx) {
     /* All display will be rendering the same content */
-    auto drawPixel = teeui::makePixelDrawer([&, this](uint32_t x, uint32_t y,
-                                                      teeui::Color color)
-                                                    -> teeui::Error {
-        TLOGD("px %u %u: %08x", x, y, color);
-        size_t pos =
-                y * fb_info_[idx].line_stride + x * fb_info_[idx].pixel_stride;
-        TLOGD("pos: %zu, bufferSize: %" PRIu32 "\n", pos, fb_info_[idx].size);
-        if (pos >= fb_info_[idx].size) {
-            return teeui::Error::OutOfBoundsDrawing;
+    auto target = RenderTarget::fromSecureFb(fb_info_[idx]);
+    ResponseCode rc;
+    if (renderWriteOnly(idx, target, &rc)) {
+        return rc;
+    }
+    if (auto frame = compositionFrame(idx)) {
+        rc = renderBlended(idx, frame->target());
+        if (rc != ResponseCode::OK) {
+            return rc;
         }
-        double alfa = (color & 0xff000000) >> 24;
-        alfa /= 255.0;
-        auto& pixel =
-                *reinterpret_cast<teeui::Color*>(fb_info_[idx].buffer + pos);
+        return streamTo(*frame, target);
+    }
+    return renderBlended(idx, target);
+}
 
-        pixel = alfaCombineChannel(0, alfa, color, pixel) |
-                alfaCombineChannel(8, alfa, color, pixel) |
-                alfaCombineChannel(16, alfa, color, pixel);
-        return teeui::Error::OK;
-    });
+OffscreenFrame* TrustyConfirmationUI::compositionFrame(uint32_t idx) {
+#if CONFIRMATIONUI_OFFSCREEN_COMPOSITION
+    if (composition_.size() < fb_info_.size()) {
+        composition_.resize(fb_info_.size());
+    }
+    auto& frame = composition_[idx];
+    if (frame.allocate(fb_info_[idx].width, fb_info_[idx].height)) {
+        return &frame;
+    }
+    TLOGW("Not enough memory for the composition frame\n");
+#endif
+    return nullptr;
+}
+
+LayoutBudget* TrustyConfirmationUI::budget(uint32_t idx) {
+    if (budgets_.size() <= idx) {
+        budgets_.resize(size_t(idx) + 1);
+    }
+    auto& slot = budgets_[idx];
+    /* Costs learned with an unknown profile are never reused. */
+    if (!known_profile_ || !slot.known || !(slot.profile == profile_)) {
+        if (known_profile_) {
+            slot.profile = profile_;
+        }
+        slot.known = known_profile_;
+        slot.costs = LayoutBudget();
+    }
+    return &slot.costs;
+}
 
+ResponseCode TrustyConfirmationUI::streamTo(const OffscreenFrame& frame,
+                                            const RenderTarget& target) {
+    if (!frame.copyTo(target)) {
+        TLOGE("Composed frame does not fit the framebuffer\n");
+        return ResponseCode::UIError;
+    }
+    return ResponseCode::OK;
+}
+
+ResponseCode TrustyConfirmationUI::render(uint32_t idx,
+                                          const RenderTarget& target) {
+    ResponseCode rc;
+    if (renderWriteOnly(idx, target, &rc)) {
+        return rc;
+    }
+    return renderBlended(idx, target);
+}
+
+bool TrustyConfirmationUI::renderWriteOnly(uint32_t idx,
+                                           const RenderTarget& target,
+                                           ResponseCode* rc) {
     TLOGI("begin rendering\n");
 
-    teeui::Color bgColor = kColorBackground;
-    if (inverted_) {
-        bgColor = kColorBackgroundInv;
+#if CONFIRMATIONUI_PALETTE_FRAME
+    if (render_path_ == RenderPath::Default) {
+        auto& frame = palette_frames_[idx];
+        if (frame.allocate(target.width, target.height)) {
+            frame.clear();
+            if (auto error = drawElements(layout_[idx],
+                                          makePaletteDrawer(&frame),
+                                          panels_[idx])) {
+                TLOGE("Element drawing failed: %u\n", error.code());
+                *rc = teeuiError2ResponseCode(error);
+                return true;
+            }
+            *rc = expand(idx, target);
+            return true;
+        }
+        TLOGW("Not enough memory for the palette frame\n");
     }
-    uint8_t* line_iter = fb_info_[idx].buffer;
-    for (uint32_t yi = 0; yi < fb_info_[idx].height; ++yi) {
-        auto pixel_iter = line_iter;
-        for (uint32_t xi = 0; xi < fb_info_[idx].width; ++xi) {
-            *reinterpret_cast<uint32_t*>(pixel_iter) = bgColor;
-            pixel_iter += fb_info_[idx].pixel_stride;
+#endif
+
+    if ((render_path_ == RenderPath::Default && kTiledRendering) ||
+        render_path_ == RenderPath::Tiled) {
+        return renderTiled(idx, target, rc);
+    }
+    return false;
+}
+
+ResponseCode TrustyConfirmationUI::renderBlended(uint32_t idx,
+                                                 const RenderTarget& target) {
+#if CONFIRMATIONUI_RENDER_THREADS > 1
+    if (render_path_ == RenderPath::Default) {
+        auto& panel = panels_[idx];
+        auto stripe_palette = palette();
+        auto error = stripes_.render(
+                layout_[idx], target, backgroundColor(inverted_),
+                [stripe_palette](const RenderTarget& stripe) {
+                    return makeBlendingDrawer(stripe, stripe_palette);
+                },
+                [&panel](auto& element, const teeui::PixelDrawer& drawPixel) {
+                    return drawElement(element, drawPixel, panel);
+                });
+        if (error.code() != teeui::Error::OutOfMemory) {
+            if (error) {
+                TLOGE("Striped element drawing failed: %u\n", error.code());
+            }
+            return teeuiError2ResponseCode(error);
         }
-        line_iter += fb_info_[idx].line_stride;
+        TLOGW("Too many pixels for striped rendering\n");
+    }
+#endif
+
+    clearTarget(target, backgroundColor(inverted_));
+
+#if CONFIRMATIONUI_RENDER_BUDGET_US
+    auto error = drawElementsWithin(layout_[idx], budget(idx), target,
+                                    palette(), backgroundColor(inverted_),
+                                    panels_[idx]);
+#else
+    auto error = drawElements(layout_[idx],
+                              makeBlendingDrawer(target, palette()),
+                              panels_[idx]);
+#endif
+    if (error) {
+        TLOGE("Element drawing failed: %u\n", error.code());
+        return teeuiError2ResponseCode(error);
+    }
+
+    return ResponseCode::OK;
+}
+
+bool TrustyConfirmationUI::renderTiled(uint32_t idx,
+                                       const RenderTarget& target,
+                                       ResponseCode* rc) {
+    if (!tiles_.allocate(target.width)) {
+        TLOGW("Not enough memory for tiled rendering\n");
+        return false;
+    }
+    auto& panel = panels_[idx];
+    auto error = tiles_.render(
+            layout_[idx], panel.extents, target, backgroundColor(inverted_),
+            [this](const RenderTarget& band) {
+                return makeBlendingDrawer(band, palette());
+            },
+            [&panel](auto& element, const teeui::PixelDrawer& drawPixel) {
+                return drawElement(element, drawPixel, panel);
+            });
+    if (error.code() == teeui::Error::OutOfMemory) {
+        TLOGW("Too many pixels span bands for tiled rendering\n");
+        return false;
+    }
+    if (error) {
+        TLOGE("Tiled element drawing failed: %u\n", error.code());
+    }
+    *rc = teeuiError2ResponseCode(error);
+    return true;
+}
+
+ResponseCode TrustyConfirmationUI::renderBodyAndSwap(uint32_t idx) {
+    using namespace teeui;
+    auto fb = RenderTarget::fromSecureFb(fb_info_[idx]);
+    auto frame = compositionFrame(idx);
+    auto target = frame ? frame->target() : fb;
+
+    TLOGI("begin rendering onto the chrome\n");
+
+    if (!chrome_[idx].copyTo(target)) {
+        TLOGE("Chrome frame does not fit the framebuffer\n");
+        return ResponseCode::UIError;
     }
 
-    if (auto error = drawElements(layout_[idx], drawPixel)) {
+    if (auto error = std::get<LabelBody>(layout_[idx])
+                             .draw(makeBlendingDrawer(target, nullptr))) {
         TLOGE("Element drawing failed: %u\n", error.code());
         return teeuiError2ResponseCode(error);
     }
 
+    if (frame) {
+        auto rc = streamTo(*frame, fb);
+        if (rc != ResponseCode::OK) {
+            return rc;
+        }
+    }
+    return present(idx);
+}
+
+ResponseCode TrustyConfirmationUI::presentChrome(uint32_t idx, bool draw) {
+    using namespace teeui;
+    if (draw) {
+        auto chrome = chrome_[idx].target();
+        clearTarget(chrome, backgroundColor(inverted_));
+        if (auto error = drawElementsExcept<LabelBody>(
+                    layout_[idx], makeBlendingDrawer(chrome, nullptr),
+                    panels_[idx])) {
+            TLOGE("Chrome drawing failed: %u\n", error.code());
+            return teeuiError2ResponseCode(error);
+        }
+    }
+    if (!chrome_[idx].copyTo(RenderTarget::fromSecureFb(fb_info_[idx]))) {
+        TLOGE("Chrome frame does not fit the framebuffer\n");
+        return ResponseCode::UIError;
+    }
+    return present(idx);
+}
+
+bool TrustyConfirmationUI::allocateChrome() {
+    chrome_.resize(panels_.size());
+    for (size_t i = 0; i < panels_.size(); ++i) {
+        if (!chrome_[i].allocate(panels_[i].width, panels_[i].height)) {
+            TLOGW("Not enough memory for a progressive first frame\n");
+            chrome_.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+ResponseCode TrustyConfirmationUI::present(uint32_t idx) {
+    front_buffers_[idx] = fb_info_[idx].buffer;
     if (auto rc = secure_fb_display_next(secure_fb_handle_[idx],
                                          &fb_info_[idx])) {
         TLOGE("secure_fb_display_next returned  %d\n", rc);
@@ -270,29 +1050,99 @@ ResponseCode TrustyConfirmationUI::renderAndSwap(uint32_t idx) {
     return ResponseCode::OK;
 }
 
+ResponseCode TrustyConfirmationUI::expand(uint32_t idx) {
+    return expand(idx, RenderTarget::fromSecureFb(fb_info_[idx]));
+}
+
+ResponseCode TrustyConfirmationUI::expand(uint32_t idx,
+                                          const RenderTarget& target) {
+    if (!palette_frames_[idx].expand(schemePalette(inverted_, enabled_),
+                                     target)) {
+        TLOGE("Palette frame does not fit the framebuffer\n");
+        return ResponseCode::UIError;
+    }
+    return ResponseCode::OK;
+}
+
+void TrustyConfirmationUI::prerenderEnabled() {
+    for (auto i = 0; i < (int)fb_info_.size(); ++i) {
+        if (fb_info_[i].buffer == front_buffers_[i]) {
+            /* Not double buffered. Drawing now would show the frame. */
+            return;
+        }
+    }
+    enabled_ = true;
+    teeui::Color color = layoutInstructionColor();
+    bool ok = true;
+    for (auto i = 0; ok && i < (int)layout_.size(); ++i) {
+        setInstructionColor(&layout_[i], color);
+#if CONFIRMATIONUI_PALETTE_FRAME
+        ok = (palette_frames_[i].isAllocated() ? expand(i) : render(i)) ==
+             ResponseCode::OK;
+#else
+        ok = render(i) == ResponseCode::OK;
+#endif
+    }
+    /*
+     * The layouts must match the displayed frame. On failure, the enabled
+     * frame is rendered again when the instructions are enabled.
+     */
+    enabled_ = false;
+    color = layoutInstructionColor();
+    for (auto& layout : layout_) {
+        setInstructionColor(&layout, color);
+    }
+    enabled_frame_ready_ = ok;
+    if (!ok) {
+        TLOGW("Failed to pre-render the enabled frame\n");
+    }
+}
+
+const Palette* TrustyConfirmationUI::palette() {
+#if CONFIRMATIONUI_PALETTE_FRAME
+    palette_ = schemePalette(inverted_, enabled_);
+    return &palette_;
+#else
+    return nullptr;
+#endif
+}
+
+teeui::Color TrustyConfirmationUI::layoutInstructionColor() const {
+#if CONFIRMATIONUI_PALETTE_FRAME
+    return paletteSentinel(PaletteSlot::Instruction);
+#else
+    return instructionColor(enabled_, inverted_);
+#endif
+}
+
 ResponseCode TrustyConfirmationUI::showInstructions(bool enable) {
     using namespace teeui;
+    if (!active_)
+        return ResponseCode::UIError;
     if (enabled_ == enable)
         return ResponseCode::OK;
     enabled_ = enable;
-    Color color;
-    if (enable) {
-        if (inverted_)
-            color = kColorEnabledInv;
-        else
-            color = kColorEnabled;
-    } else {
-        if (inverted_)
-            color = kColorDisabledInv;
-        else
-            color = kColorDisabled;
-    }
+    Color color = layoutInstructionColor();
     ResponseCode rc = ResponseCode::OK;
+    bool prerendered = enable && enabled_frame_ready_;
+    enabled_frame_ready_ = false;
     for (auto i = 0; i < (int)layout_.size(); ++i) {
-        std::get<LabelOK>(layout_[i]).setTextColor(color);
-        std::get<LabelCancel>(layout_[i]).setTextColor(color);
+        setInstructionColor(&layout_[i], color);
         if (enable) {
-            rc = renderAndSwap(i);
+            if (prerendered) {
+                /* start() left the enabled frame in the back buffer. */
+                rc = present(i);
+            } else {
+#if CONFIRMATIONUI_PALETTE_FRAME
+                /* Only the palette changes. Expand without re-rendering. */
+                rc = palette_frames_[i].isAllocated() ? expand(i) : render(i);
+#else
+                rc = render(i);
+#endif
+                if (rc == ResponseCode::OK) {
+                    rc = present(i);
+                }
+            }
             if (rc != ResponseCode::OK) {
                 stop();
                 break;
@@ -302,11 +1152,43 @@ ResponseCode TrustyConfirmationUI::showInstructions(bool enable) {
     return rc;
 }
 
-void TrustyConfirmationUI::stop() {
+void TrustyConfirmationUI::blank() {
+    TLOGI("calling gui blank\n");
+    active_ = false;
+    enabled_frame_ready_ = false;
+    for (auto i = 0; i < (int)secure_fb_handle_.size(); ++i) {
+        if (!secure_fb_handle_[i]) {
+            continue;
+        }
+        clearTarget(RenderTarget::fromSecureFb(fb_info_[i]),
+                    backgroundColor(inverted_));
+        if (present(i) != ResponseCode::OK) {
+            /* We cannot blank this display. Close it right away. */
+            secure_fb_close(secure_fb_handle_[i]);
+            secure_fb_handle_[i] = NULL;
+        }
+    }
+    TLOGI("calling gui blank - done\n");
+}
+
+void TrustyConfirmationUI::release() {
     TLOGI("calling gui stop\n");
+    active_ = false;
+    discardPrewarm();
+    closeFramebuffers();
+    tiles_.release();
+#if CONFIRMATIONUI_RENDER_THREADS > 1
+    stripes_.release();
+#endif
+    palette_frames_.clear();
+    TLOGI("calling gui stop - done\n");
+}
+
+void TrustyConfirmationUI::closeFramebuffers() {
     for (auto& secure_fb_handle: secure_fb_handle_) {
-        secure_fb_close(secure_fb_handle);
-        secure_fb_handle = NULL;
+        if (secure_fb_handle) {
+            secure_fb_close(secure_fb_handle);
+            secure_fb_handle = NULL;
+        }
     }
-    TLOGI("calling gui stop - done\n");
 }
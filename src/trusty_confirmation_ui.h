@@ -19,6 +19,7 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <memory>
 #include <vector>
 
 #include <layouts/layout.h>
@@ -30,9 +31,58 @@
 
 #include <secure_input/secure_input_proto.h>
 
+#include "button_shapes.h"
+#include "offscreen_frame.h"
+#include "palette_frame.h"
+#include "render_budget.h"
+#include "sprite_cache.h"
+#include "stripe_renderer.h"
+#include "tiled_renderer.h"
+#include "trusty_time_stamper.h"
+
+/* Elements that are fixed for a given density and color scheme. */
+using IconSprites =
+        SpriteSet<teeui::IconShield, teeui::IconPower, teeui::IconVolUp>;
+
+/* Button elements drawn by the scanline rasterizer. */
+using IconShapes = ButtonShapes<teeui::IconPower, teeui::IconVolUp>;
+
+/* Per element render cost of the layout of one display. */
+using LayoutBudget = RenderBudget<
+        std::tuple_size<teeui::layout_t<teeui::ConfUILayout>>::value>;
+
+/*
+ * Render state of one display that is derived from its device context along
+ * with the layout.
+ */
+struct PanelState {
+    uint32_t width;
+    uint32_t height;
+    RowExtents<teeui::layout_t<teeui::ConfUILayout>> extents;
+    IconShapes shapes;
+    /* Shared by all copies of a cached layout. Null for runtime contexts. */
+    std::shared_ptr<IconSprites> sprites;
+};
+
 class TrustyConfirmationUI {
 public:
-    TrustyConfirmationUI() = default;
+    TrustyConfirmationUI()
+            : active_(false),
+              enabled_frame_ready_(false),
+              render_path_(RenderPath::Default),
+              known_profile_(false),
+              prewarmed_(false) {}
+    ~TrustyConfirmationUI() { release(); }
+
+    /**
+     * Prepares the UI before the prompt is known. Resolves the device
+     * contexts, instantiates the layouts, and renders everything but the
+     * prompt body into offscreen frames, using the language and accessibility
+     * options of the previous session as the best guess for the next one.
+     * start() reuses this work if its arguments match the guess and discards
+     * it otherwise. Nothing is displayed and no framebuffer is opened.
+     */
+    void prewarm();
 
     /**
      * Renders and displays the dialog.
@@ -40,6 +90,14 @@ public:
      * lang_id: The locale to use. Selects the language used for the button
      * texts and instructions. inverted: If set, the inverted color scheme is
      * used. magnified: If set, the magnified font profile is used.
+     * begin: When the request was dispatched. The time to the first and to
+     * the full frame is recorded relative to it.
+     *
+     * With CONFIRMATIONUI_PROGRESSIVE_FRAME, the chrome, i.e., everything
+     * but the prompt body, is presented on all displays before the body is
+     * rendered, and the full frame is presented in a second flip. The
+     * instructions are disabled in both frames, and start() returns only
+     * after the full frame is shown, so no input is accepted before.
      *
      * Returns ResponseCode::OK if the UI was successfully start.
      * Returns ResponseCode::UIError if the secure display could not be enabled
@@ -48,13 +106,17 @@ public:
      * ResponseCode::UIErrorMessageTooLong if the any of the strings could not
      * be fully rendered on the screen.
      */
-    teeui::ResponseCode start(const char* promt,
-                              const char* lang_id,
-                              bool inverted,
-                              bool magnified);
+    teeui::ResponseCode start(
+            const char* promt,
+            const char* lang_id,
+            bool inverted,
+            bool magnified,
+            monotonic_time_stamper::PreciseTimeStamp begin = {});
     /**
      * Toggles the color profile of the buttons/button labels indicating to the
      * user that input enabled (enable == true) or disabled (enabled == false).
+     * start() renders the enabled frame ahead of time if the framebuffers are
+     * double buffered, in which case enabling only presents it.
      *
      * Returns ResponseCode::OK if the UI was successfully updated.
      * Returns ResponseCode::UIError if the secure framebuffer could not be
@@ -62,10 +124,81 @@ public:
      */
     teeui::ResponseCode showInstructions(bool enable);
 
+    /* Render paths that renderOffscreen() can be limited to. */
+    enum class RenderPath {
+        /* The paths selected by the build options. */
+        Default,
+        /* Clearing the target and drawing the elements into it. */
+        Direct,
+        /* TiledRenderer, even without CONFIRMATIONUI_TILED_RENDERING. */
+        Tiled,
+    };
+
+    /**
+     * Renders the dialog for one display into an offscreen frame instead of
+     * the framebuffer. Everything start() does, except for opening and
+     * presenting the framebuffers, is done the same way. The frame is
+     * allocated with the geometry of the display. Used by the render sweep,
+     * which compares the render paths with the path argument.
+     *
+     * Returns ResponseCode::OperationPending while a session is active,
+     * ResponseCode::UIError if there is no such display, and
+     * ResponseCode::SystemError if the frame cannot be allocated. Other errors
+     * same as start() above.
+     */
+    teeui::ResponseCode renderOffscreen(const char* prompt,
+                                        const char* lang_id,
+                                        bool inverted,
+                                        bool magnified,
+                                        uint32_t display,
+                                        OffscreenFrame* frame,
+                                        RenderPath path = RenderPath::Default);
+
+    /**
+     * Instantiates the layouts for the profile of the previous session and
+     * draws them once, discarding the pixels. This fills the layout cache and
+     * the icon sprites, and pages in the font and translation data, so that
+     * the first session does not pay for it. Used at startup with
+     * CONFIRMATIONUI_EAGER_INIT.
+     */
+    static void warmUp();
+
+    /**
+     * Clears the back buffer of every display with the background color and
+     * presents it. Reports the time spent writing and flipping, summed over
+     * all displays, and the number of bytes written. Used by the self-test
+     * to measure the framebuffer write speed and the flip latency. The
+     * prompt is no longer shown afterwards.
+     *
+     * Returns ResponseCode::UIError if no prompt is shown or a flip failed.
+     */
+    teeui::ResponseCode benchmarkFramebuffers(uint64_t* fill_us,
+                                              uint64_t* flip_us,
+                                              uint64_t* bytes);
+
+    /* Number of displays the UI is rendered to. */
+    static size_t displayCount();
+
+    /**
+     * Ends the session without waiting for the display to be released. Blanks
+     * all displays and rejects further updates. The framebuffers stay open
+     * until release() is called, e.g., after the response to the client has
+     * been sent.
+     */
+    void blank();
+
+    /**
+     * Closes the secure framebuffers and frees up all of the related
+     * resources.
+     */
+    void release();
+
     /**
      * Stops the secure display and frees up all of the related resources.
+     * Same as release() since closing the framebuffers ends the secure
+     * display.
      */
-    void stop();
+    void stop() { release(); }
 
     // TrustyConfirmationUI not copyable
     TrustyConfirmationUI& operator=(const TrustyConfirmationUI&) = delete;
@@ -77,15 +210,149 @@ public:
     }
 
 private:
-    teeui::Error updateTranslations(uint32_t idx);
+    struct Profile {
+        static constexpr const size_t kMaxLangIdSize = 32;
+        char lang_id[kMaxLangIdSize];
+        bool inverted;
+        bool magnified;
+
+        bool set(const char* lang, bool inverted, bool magnified);
+        bool operator==(const Profile& other) const;
+    };
+
+    /*
+     * Element costs of one display learned with profile, which is only valid
+     * if known is set.
+     */
+    struct ProfileBudget {
+        Profile profile;
+        bool known = false;
+        LayoutBudget costs;
+    };
+
     teeui::ResponseCode renderAndSwap(uint32_t idx);
+    /* Renders into the back buffer of the display without presenting it. */
+    teeui::ResponseCode render(uint32_t idx);
+    /* Renders the layout of display idx into the given target. */
+    teeui::ResponseCode render(uint32_t idx, const RenderTarget& target);
+    /*
+     * Renders the layout of display idx into target with a path that never
+     * reads target back, i.e., the palette frame or tiled rendering, if
+     * enabled. Returns false without an error if it could not, and the
+     * caller must render with renderBlended().
+     */
+    bool renderWriteOnly(uint32_t idx,
+                         const RenderTarget& target,
+                         teeui::ResponseCode* rc);
+    /* Clears target and blends the layout of display idx into it. */
+    teeui::ResponseCode renderBlended(uint32_t idx,
+                                      const RenderTarget& target);
+    /*
+     * Renders the layout of display idx into target with TiledRenderer.
+     * Returns false without an error if it could not, and the caller must
+     * render another way.
+     */
+    bool renderTiled(uint32_t idx,
+                     const RenderTarget& target,
+                     teeui::ResponseCode* rc);
+    teeui::ResponseCode renderBodyAndSwap(uint32_t idx);
+    /*
+     * Presents the chrome of display idx from chrome_, after drawing it
+     * there if draw is set.
+     */
+    teeui::ResponseCode presentChrome(uint32_t idx, bool draw);
+    /* Allocates a chrome_ frame for every display. */
+    bool allocateChrome();
+    teeui::ResponseCode present(uint32_t idx);
+    /*
+     * The composition frame of display idx to blend in, or null if frames
+     * are blended in the framebuffer. See composition_.
+     */
+    OffscreenFrame* compositionFrame(uint32_t idx);
+    /*
+     * The element costs of display idx for the profile of this session. They
+     * are reset if they were learned with another profile, so the next render
+     * seeds them.
+     */
+    LayoutBudget* budget(uint32_t idx);
+    /* Writes a composed frame to the framebuffer. */
+    static teeui::ResponseCode streamTo(const OffscreenFrame& frame,
+                                        const RenderTarget& target);
+    teeui::ResponseCode expand(uint32_t idx);
+    teeui::ResponseCode expand(uint32_t idx, const RenderTarget& target);
+    /*
+     * Renders the frame with enabled instructions into the back buffers,
+     * so that showInstructions(true) only needs to present them.
+     */
+    void prerenderEnabled();
+    /* The palette to resolve the layout colors with, or null. */
+    const Palette* palette();
+    /* The instruction text color to set in the layouts. */
+    teeui::Color layoutInstructionColor() const;
+    void closeFramebuffers();
+    bool takePrewarmed(const Profile& profile);
+    void discardPrewarm();
+
+    /* The best guess for the next session. See prewarm(). */
+    static Profile last_profile_;
+    /*
+     * With CONFIRMATIONUI_RENDER_BUDGET_US, the element costs learned on each
+     * display, shared by all channels and kept across sessions like the
+     * pre-warmed layouts. See budget().
+     */
+    static std::vector<ProfileBudget> budgets_;
+    /*
+     * With CONFIRMATIONUI_OFFSCREEN_COMPOSITION, frames that are blended
+     * rather than written by renderWriteOnly() are cleared and blended in
+     * these cacheable frames, one per display, and written to the framebuffer
+     * in one sequential copy, so the framebuffer is never read. Only one
+     * frame is rendered at a time, so they are shared by all channels and
+     * kept across sessions.
+     */
+    static std::vector<OffscreenFrame> composition_;
 
     std::vector<secure_fb_info> fb_info_;
     std::vector<secure_fb_handle_t> secure_fb_handle_;
+    /* The buffer of each display that was presented last. */
+    std::vector<uint8_t*> front_buffers_;
 
     uint32_t rotation_;
     bool inverted_;
     bool enabled_;
+    /* Set while the UI shows a prompt that may still be updated. */
+    bool active_;
+    /* Set if the back buffers hold the frame with enabled instructions. */
+    bool enabled_frame_ready_;
+    /* Set by renderOffscreen() for the duration of the render. */
+    RenderPath render_path_;
+    /* The profile of this session, if it has one. See Profile::set(). */
+    Profile profile_;
+    bool known_profile_;
 
     std::vector<teeui::layout_t<teeui::ConfUILayout>> layout_;
+    std::vector<PanelState> panels_;
+    TiledRenderer tiles_;
+#if CONFIRMATIONUI_RENDER_THREADS > 1
+    StripeRenderer stripes_;
+#endif
+
+    /*
+     * With CONFIRMATIONUI_PALETTE_FRAME, the layouts use palette sentinel
+     * colors. Each display is rendered into a PaletteFrame, and the frame is
+     * expanded with palette_ for the current color scheme and input state.
+     */
+    std::vector<PaletteFrame> palette_frames_;
+    Palette palette_;
+
+
+    /*
+     * Pre-warmed layouts and prompt independent frames, valid if prewarmed_
+     * is set. See prewarm(). The progressive first frame of start() also
+     * keeps the chrome in chrome_.
+     */
+    bool prewarmed_;
+    Profile prewarm_profile_;
+    std::vector<teeui::layout_t<teeui::ConfUILayout>> prewarm_layout_;
+    std::vector<PanelState> prewarm_panels_;
+    std::vector<OffscreenFrame> chrome_;
 };
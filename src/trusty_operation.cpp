@@ -18,7 +18,19 @@
 #include <secure_input/secure_input_proto.h>
 #include <teeui/msg_formatting.h>
 
+#include "memory_stats.h"
+#include "prompt_preflight.h"
+#include "render_sweep.h"
+#include "request_recorder.h"
+#include "secure_input_batch_proto.h"
+#include "self_test.h"
+#include "session_telemetry.h"
+#include "telemetry_proto.h"
+
 #include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
 
 #include <openssl/hmac.h>
 #include <openssl/sha.h>
@@ -44,25 +56,47 @@ using teeui::TestModeCommands;
 
 using secure_input::InputResponse;
 
+TrustyOperation::PreciseTimeStamp TrustyOperation::dispatch_time_;
+
 optional<Hmac> TrustyOperation::hmac256(
         const AuthTokenKey& key,
         std::initializer_list<ByteBufferProxy> buffers) {
     HMAC_CTX hmacCtx;
     HMAC_CTX_init(&hmacCtx);
+    /* HMAC_CTX_cleanup zeroizes the key schedule left on the stack. */
+    auto cleanup = [&](optional<Hmac> result) {
+        HMAC_CTX_cleanup(&hmacCtx);
+        return result;
+    };
     if (!HMAC_Init_ex(&hmacCtx, key.data(), key.size(), EVP_sha256(),
                       nullptr)) {
-        return {};
+        return cleanup({});
     }
     for (auto& buffer : buffers) {
         if (!HMAC_Update(&hmacCtx, buffer.data(), buffer.size())) {
-            return {};
+            return cleanup({});
         }
     }
     Hmac result;
     if (!HMAC_Final(&hmacCtx, result.data(), nullptr)) {
-        return {};
+        return cleanup({});
+    }
+    return cleanup(result);
+}
+
+void TrustyOperation::setHmacKey(const AuthTokenKey& key) {
+    Operation::setHmacKey(key);
+    hmac_.prepare(key);
+    /* A token prepared with the old key would not match signConfirmation. */
+    if (confirmation_token_.isReady()) {
+        prepareConfirmationToken();
     }
-    return result;
+}
+
+void TrustyOperation::prewarm() {
+#if CONFIRMATIONUI_PREWARM
+    gui_.prewarm();
+#endif
 }
 
 int TrustyOperation::handleMsg(void* msg,
@@ -72,8 +106,13 @@ int TrustyOperation::handleMsg(void* msg,
     ReadStream in(reinterpret_cast<uint8_t*>(msg), msglen);
     WriteStream out(reinterpret_cast<uint8_t*>(reponse), *responselen);
 
+    dispatch_time_ = monotonic_time_stamper::nowPrecise();
+    last_activity_ = dispatch_time_.millis();
+
     TLOGI("proto: %u cmd: %u\n", reinterpret_cast<uint32_t*>(msg)[0],
           reinterpret_cast<uint32_t*>(msg)[1]);
+    memory::Scope memory(reinterpret_cast<uint32_t*>(msg)[0],
+                         reinterpret_cast<uint32_t*>(msg)[1]);
 
     auto result = dispatchCommandMessage(in, out);
     if (!result) {
@@ -86,56 +125,321 @@ int TrustyOperation::handleMsg(void* msg,
         result = write(Message<ResponseCode>(), out, ResponseCode::SystemError);
     }
     *responselen = result.pos() - reinterpret_cast<uint8_t*>(reponse);
+    dispatch_time_ = {};
     return 0;
 }
 
 ResponseCode TrustyOperation::initHook() {
-    auto rc = gui_.start(getPrompt().data(), languageIdBuffer_,
-                         invertedColorModeRequested_, maginifiedViewRequested_);
+    /* Everything since the start of dispatch was spent parsing the prompt. */
+    telemetry::record(CONFIRMATIONUI_PHASE_PROMPT, dispatch_time_);
+
+    /* Reject prompts that cannot be rendered before touching the display. */
+    auto rc = preflightPrompt(getPrompt().data());
+    if (rc != ResponseCode::OK) {
+        TLOGE("Prompt preflight failed: %u\n", rc);
+        return rc;
+    }
+
+    /* The key schedule is zeroized when a session is aborted. */
+    if (!hmac_.isPrepared() && !hmac_.prepare(*hmacKey())) {
+        return ResponseCode::SystemError;
+    }
+
+    telemetry::PhaseTimer timer(CONFIRMATIONUI_PHASE_RENDER);
+    rc = gui_.start(getPrompt().data(), languageIdBuffer_,
+                    invertedColorModeRequested_, maginifiedViewRequested_,
+                    dispatch_time_);
     if (rc != ResponseCode::OK) {
         TLOGE("GUI start returned: %d\n", rc);
+        timer.fail();
     } else {
-        input_tracker_.newSession();
+        telemetry::recordStartup(CONFIRMATIONUI_STARTUP_FIRST_PROMPT,
+                                 dispatch_time_);
+        /*
+         * The pre-input grace period starts when the frame is shown, not when
+         * the message was dispatched, so sample the clock again.
+         */
+        input_tracker_.newSession(monotonic_time_stamper::now());
+        session_active_ = true;
+        /*
+         * The UI is up and the user needs at least
+         * kUserPreInputGracePeriodMillis to react, so this is a good time to
+         * generate the nonces for the upcoming handshakes.
+         */
+        if (!input_tracker_.fillNoncePool()) {
+            TLOGW("Failed to pre-generate handshake nonces\n");
+        }
+        /* Likewise, hash the message now rather than after confirmation. */
+        if (!prepareConfirmationToken()) {
+            TLOGW("Failed to prepare the confirmation token\n");
+        }
     }
     TLOGI("initHook: %u\n", rc);
     return rc;
 }
 
 void TrustyOperation::abortHook() {
+    telemetry::PhaseTimer timer(CONFIRMATIONUI_PHASE_TEARDOWN);
+    session_active_ = false;
     input_tracker_.abort();
-    gui_.stop();
+    hmac_.clear();
+    confirmation_token_.clear();
+    gui_.blank();
+    release_pending_ = true;
 }
 
 void TrustyOperation::finalizeHook() {
-    gui_.stop();
+    telemetry::PhaseTimer timer(CONFIRMATIONUI_PHASE_TEARDOWN);
+    session_active_ = false;
+    /* Nonces pooled for this session are not handed to the next one. */
+    input_tracker_.abort();
+    confirmation_token_.clear();
+    gui_.blank();
+    release_pending_ = true;
+}
+
+void TrustyOperation::runDeferredWork() {
+    if (release_pending_) {
+        telemetry::PhaseTimer timer(CONFIRMATIONUI_PHASE_RELEASE);
+        gui_.release();
+        release_pending_ = false;
+    }
+    if (session_active_) {
+        /* Replace the nonce a handshake may just have used. */
+        input_tracker_.fillNoncePool();
+    }
+}
+
+TrustyOperation::TimeStamp TrustyOperation::sessionDeadline() const {
+    if (!session_active_ || !last_activity_.isOk() || !last_activity_) {
+        return 0;
+    }
+    return last_activity_ + CONFIRMATIONUI_SESSION_TIMEOUT_MS;
+}
+
+void TrustyOperation::expireSession(TimeStamp now) {
+    auto deadline = sessionDeadline();
+    if (deadline && now >= deadline) {
+        TLOGI("Session expired, aborting\n");
+        abort();
+    }
 }
 
 ResponseCode TrustyOperation::testCommandHook(TestModeCommands testCmd) {
+#if CONFIRMATIONUI_SELF_TEST
+    /* Not a TestModeCommands enumerator. See telemetry_proto.h. */
+    if (testCmd == telemetry::kRunSelfTest) {
+        confirmationui_self_test report = {};
+        auto rc = runSelfTest(&report);
+        auto& render = report.steps[CONFIRMATIONUI_SELF_TEST_FULL_RENDER];
+        TLOGI("test mode self-test: status %u, full render max %u us, "
+              "%u of %u steps failed\n",
+              uint32_t(rc), render.max_us,
+              uint32_t(std::count_if(
+                      report.steps, report.steps + report.step_count,
+                      [](const auto& step) { return step.status != 0; })),
+              report.step_count);
+        return rc;
+    }
+#endif
     switch (testCmd) {
     case TestModeCommands::OK_EVENT:
         return input_tracker_.reportVerifiedInput(
-                InputTracker::InputEvent::UserConfirm);
+                InputTracker::InputEvent::UserConfirm, now());
     case TestModeCommands::CANCEL_EVENT:
         return input_tracker_.reportVerifiedInput(
-                InputTracker::InputEvent::UserCancel);
+                InputTracker::InputEvent::UserCancel, now());
     default:
         /* we don't want to veto any unknown test commands. */
         return ResponseCode::OK;
     }
 }
 
+ResponseCode TrustyOperation::runSelfTest(confirmationui_self_test* report) {
+#if CONFIRMATIONUI_SELF_TEST
+    if (session_active_) {
+        return ResponseCode::OperationPending;
+    }
+    /* The self-test releases the display when it is done. */
+    release_pending_ = false;
+    return selftest::run(&gui_, report);
+#else
+    (void)report;
+    return ResponseCode::Unimplemented;
+#endif
+}
+
+bool TrustyOperation::prepareConfirmationToken() {
+    return confirmation_token_.absorb(hmac_,
+                                      HmacKeySchedule::Label::ConfirmationToken,
+                                      {getMessage()});
+}
+
+void TrustyOperation::signPreparedConfirmation() {
+    if (!confirmation_token_.isReady()) {
+        signConfirmation(*hmacKey());
+        return;
+    }
+    if (error_ != ResponseCode::Ignored) {
+        return;
+    }
+    auto token = confirmation_token_.finish();
+    if (!token) {
+        error_ = ResponseCode::SystemError;
+        return;
+    }
+#if CONFIRMATIONUI_SELF_TEST
+    /*
+     * Sign the same message of this operation the way teeui does, and refuse
+     * to confirm if the prepared token differs.
+     */
+    signConfirmation(*hmacKey());
+    if (error_ != ResponseCode::OK ||
+        memcmp(confirmationToken_.data(), token->data(), token->size())) {
+        TLOGE("Prepared confirmation token differs from signConfirmation\n");
+        error_ = ResponseCode::SystemError;
+        return;
+    }
+#endif
+    confirmationToken_ = *token;
+    error_ = ResponseCode::OK;
+}
+
+void TrustyOperation::concludeInput() {
+    switch (input_tracker_.fetchInputEvent()) {
+    case ResponseCode::OK:
+        signPreparedConfirmation();
+        break;
+    case ResponseCode::Canceled:
+        userCancel();
+        break;
+    default:
+        break;
+    }
+}
+
+WriteStream TrustyOperation::telemetryProtocol(ReadStream in,
+                                               WriteStream out) {
+    using namespace telemetry;
+    auto [in_cmd, cmd] = teeui::readCmd<TelemetryCommand>(in);
+    switch (cmd) {
+    case TelemetryCommand::GetSessionStats: {
+        auto& stats = snapshot();
+        auto begin = reinterpret_cast<const uint8_t*>(&stats);
+        return write(GetSessionStatsResponse(), out, ResponseCode::OK,
+                     teeui::MsgVector<uint8_t>(begin, begin + sizeof(stats)));
+    }
+#if CONFIRMATIONUI_MEMORY_STATS
+    case TelemetryCommand::GetMemoryStats: {
+        auto& stats = memory::snapshot();
+        auto begin = reinterpret_cast<const uint8_t*>(&stats);
+        return write(GetMemoryStatsResponse(), out, ResponseCode::OK,
+                     teeui::MsgVector<uint8_t>(begin, begin + sizeof(stats)));
+    }
+#endif
+#if CONFIRMATIONUI_RENDER_SWEEP
+    case TelemetryCommand::RunRenderSweep: {
+        std::vector<uint8_t> report;
+        auto rc = sweep::run(&gui_, &report);
+        if (rc != ResponseCode::OK) {
+            return write(Message<ResponseCode>(), out, rc);
+        }
+        return write(RunRenderSweepResponse(), out, ResponseCode::OK,
+                     teeui::MsgVector<uint8_t>(report.data(),
+                                               report.data() + report.size()));
+    }
+#endif
+    case TelemetryCommand::RunSelfTest: {
+        confirmationui_self_test report;
+        auto rc = runSelfTest(&report);
+        if (rc == ResponseCode::OperationPending ||
+            rc == ResponseCode::Unimplemented) {
+            return write(Message<ResponseCode>(), out, rc);
+        }
+        auto begin = reinterpret_cast<const uint8_t*>(&report);
+        return write(RunSelfTestResponse(), out, rc,
+                     teeui::MsgVector<uint8_t>(begin, begin + sizeof(report)));
+    }
+    case TelemetryCommand::Invalid:
+    default:
+        return write(Message<ResponseCode>(), out, ResponseCode::Unimplemented);
+    }
+}
+
+#if CONFIRMATIONUI_RECORDER
+WriteStream TrustyOperation::recorderProtocol(ReadStream in, WriteStream out) {
+    using namespace recorder;
+    auto [in_cmd, cmd] = teeui::readCmd<RecorderCommand>(in);
+    switch (cmd) {
+    case RecorderCommand::GetRecording: {
+        auto [in_offset, offset] = read(GetRecording(), in_cmd);
+        if (!in_offset) {
+            return write(Message<ResponseCode>(), out,
+                         ResponseCode::SystemError);
+        }
+        uint8_t chunk[kMaxRecordingChunk];
+        size_t len = recorder::read(offset, chunk, sizeof(chunk));
+        return write(GetRecordingResponse(), out, ResponseCode::OK,
+                     recorder::size(),
+                     teeui::MsgVector<uint8_t>(chunk, chunk + len));
+    }
+    case RecorderCommand::ResetRecording:
+        reset();
+        return write(Message<ResponseCode>(), out, ResponseCode::OK);
+    case RecorderCommand::Invalid:
+    default:
+        return write(Message<ResponseCode>(), out, ResponseCode::Unimplemented);
+    }
+}
+#endif
+
 WriteStream TrustyOperation::extendedProtocolHook(Protocol proto,
                                                   ReadStream in,
                                                   WriteStream out) {
     using namespace secure_input;
+    if (proto == telemetry::kTelemetryProto) {
+        return telemetryProtocol(in, out);
+    }
+#if CONFIRMATIONUI_RECORDER
+    if (proto == recorder::kRecorderProto) {
+        return recorderProtocol(in, out);
+    }
+#endif
     if (proto != kSecureInputProto) {
         /* this write ResponseCodeU::Unimplemented to the output stream */
         return this->Operation::extendedProtocolHook(proto, in, out);
     }
     auto [in_cmd, cmd] = teeui::readCmd<SecureInputCommand>(in);
+    /* Not a SecureInputCommand enumerator. See secure_input_batch_proto.h. */
+    if (cmd == kDeliverInputEventBatch) {
+        telemetry::PhaseTimer timer(CONFIRMATIONUI_PHASE_INPUT_EVENT,
+                                    dispatch_time_);
+        auto [in_msg, events, signature] =
+                read(DeliverInputEventBatch(), in_cmd);
+        std::vector<InputResponse> irs;
+        auto rc = ResponseCode::Unexpected;
+        if (in_msg) {
+            std::tie(rc, irs) = input_tracker_.processInputEventBatch(
+                    events, signature, hmac_, now());
+        }
+        if (rc != ResponseCode::OK) {
+            timer.fail();
+            abort();
+            irs.clear();
+        } else if (std::find(irs.begin(), irs.end(), InputResponse::OK) !=
+                   irs.end()) {
+            concludeInput();
+        }
+        teeui::MsgVector<uint8_t> results(irs.size());
+        std::transform(irs.begin(), irs.end(), results.begin(),
+                       [](InputResponse ir) { return uint8_t(ir); });
+        return write(DeliverInputEventBatchResponse(), out, rc, results);
+    }
     switch (cmd) {
     case SecureInputCommand::InputHandshake: {
-        auto [rc, nonce] = input_tracker_.beginHandshake();
+        telemetry::PhaseTimer timer(CONFIRMATIONUI_PHASE_HANDSHAKE,
+                                    dispatch_time_);
+        auto [rc, nonce] = input_tracker_.beginHandshake(now());
         if (rc != ResponseCode::OK) {
             TLOGE("beginHandshake failed\n");
             abort();
@@ -144,42 +448,43 @@ WriteStream TrustyOperation::extendedProtocolHook(Protocol proto,
             TLOGE("showInstructions failed\n");
             abort();
         }
+        if (rc != ResponseCode::OK)
+            timer.fail();
         return write(InputHandshakeResponse(), out, rc, nonce);
     }
     case SecureInputCommand::FinalizeInputSession: {
+        telemetry::PhaseTimer timer(CONFIRMATIONUI_PHASE_FINALIZE,
+                                    dispatch_time_);
         auto [in_msg, nCi, signature] =
                 read(FinalizeInputSessionHandshake(), in_cmd);
         auto rc = ResponseCode::Unexpected;
         if (in_msg) {
-            rc = input_tracker_.finalizeHandshake(nCi, signature, *hmacKey());
+            rc = input_tracker_.finalizeHandshake(nCi, signature, hmac_,
+                                                   now());
         } else {
             TLOGE("Message Parse Error\n");
         }
-        if (rc != ResponseCode::OK)
+        if (rc != ResponseCode::OK) {
+            timer.fail();
             abort();
+        }
         return write(FinalizeInputSessionHandshakeResponse(), out, rc);
     }
     case SecureInputCommand::DeliverInputEvent: {
+        telemetry::PhaseTimer timer(CONFIRMATIONUI_PHASE_INPUT_EVENT,
+                                    dispatch_time_);
         auto [in_msg, event, signature] = read(DeliverInputEvent(), in_cmd);
         InputResponse ir;
         auto rc = ResponseCode::Unexpected;
         if (in_msg) {
             std::tie(rc, ir) = input_tracker_.processInputEvent(
-                    event, signature, *hmacKey());
+                    event, signature, hmac_, now());
         }
-        if (rc != ResponseCode::OK)
+        if (rc != ResponseCode::OK) {
+            timer.fail();
             abort();
-        else if (ir == InputResponse::OK) {
-            switch (input_tracker_.fetchInputEvent()) {
-            case ResponseCode::OK:
-                signConfirmation(*hmacKey());
-                break;
-            case ResponseCode::Canceled:
-                userCancel();
-                break;
-            default:
-                break;
-            }
+        } else if (ir == InputResponse::OK) {
+            concludeInput();
         }
         return write(DeliverInputEventResponse(), out, rc, ir);
     }
@@ -22,16 +22,47 @@
 
 #include <secure_input/secure_input_proto.h>
 
+#include "hmac_key_schedule.h"
 #include "secure_input_tracker.h"
+#include "telemetry_proto.h"
 #include "trusty_confirmation_ui.h"
 #include "trusty_time_stamper.h"
 
+/*
+ * A session that sees no message from the client for this long is considered
+ * abandoned and is aborted, which releases the secure display.
+ */
+#ifndef CONFIRMATIONUI_SESSION_TIMEOUT_MS
+#define CONFIRMATIONUI_SESSION_TIMEOUT_MS (5 * 60 * 1000)
+#endif
+
 class TrustyOperation
         : public teeui::Operation<TrustyOperation,
                                   monotonic_time_stamper::TimeStamp> {
 public:
     TrustyOperation()
-            : Operation<TrustyOperation, monotonic_time_stamper::TimeStamp>() {}
+            : Operation<TrustyOperation, monotonic_time_stamper::TimeStamp>(),
+              session_active_(false),
+              release_pending_(false) {}
+
+    /*
+     * Shadows Operation::setHmacKey so that the HMAC key schedule is prepared
+     * once per key rather than once per MAC.
+     */
+    void setHmacKey(const teeui::AuthTokenKey& key);
+
+    /*
+     * Called once the channel is initialized, before the prompt arrives. Does
+     * nothing unless the TA is built with CONFIRMATIONUI_PREWARM.
+     */
+    void prewarm();
+
+    /*
+     * Performs work that was deferred until after the response to the last
+     * message was sent, e.g., releasing the secure display after a session
+     * ended.
+     */
+    void runDeferredWork();
 
     int handleMsg(void* msg,
                   uint32_t msglen,
@@ -57,9 +88,74 @@ public:
             const teeui::AuthTokenKey& key,
             std::initializer_list<teeui::ByteBufferProxy> buffers);
     using TimeStamp = monotonic_time_stamper::TimeStamp;
-    static TimeStamp now() { return monotonic_time_stamper::now(); }
+    using PreciseTimeStamp = monotonic_time_stamper::PreciseTimeStamp;
+    /*
+     * While a message is dispatched, this returns the single clock sample
+     * taken for it, so that teeui::Operation, the input tracker, and the
+     * telemetry all agree on the time of the message.
+     */
+    static TimeStamp now() {
+        if (dispatch_time_.isOk())
+            return dispatch_time_.millis();
+        return monotonic_time_stamper::now();
+    }
+
+    /*
+     * Deadlines for the event loop's timer wheel. Both return 0 if there is
+     * nothing to wait for.
+     */
+    TimeStamp sessionDeadline() const;
+    TimeStamp doubleClickDeadline() const {
+        return input_tracker_.doubleClickDeadline();
+    }
+    /* Aborts the session if it was abandoned by the client. */
+    void expireSession(TimeStamp now);
+    void expireDoubleClick(TimeStamp now) {
+        input_tracker_.expirePendingInput(now);
+    }
 
 private:
+    /*
+     * Fetches the final input event and either signs the confirmation or
+     * cancels the operation accordingly.
+     */
+    void concludeInput();
+    /*
+     * Absorbs the formatted message into confirmation_token_ so that
+     * confirming only finishes the MAC. Returns false if that failed.
+     */
+    bool prepareConfirmationToken();
+    /*
+     * Same as Operation::signConfirmation, but finishes the token prepared by
+     * prepareConfirmationToken(). Falls back to signConfirmation if there is
+     * none. With CONFIRMATIONUI_SELF_TEST, it also runs signConfirmation and
+     * fails with ResponseCode::SystemError if the tokens differ.
+     */
+    void signPreparedConfirmation();
+    teeui::WriteStream telemetryProtocol(teeui::ReadStream in,
+                                         teeui::WriteStream out);
+    /*
+     * Runs the self-test unless a session is active. See self_test.h. Returns
+     * ResponseCode::Unimplemented unless the TA is built with
+     * CONFIRMATIONUI_SELF_TEST.
+     */
+    teeui::ResponseCode runSelfTest(confirmationui_self_test* report);
+#if CONFIRMATIONUI_RECORDER
+    teeui::WriteStream recorderProtocol(teeui::ReadStream in,
+                                        teeui::WriteStream out);
+#endif
+
     TrustyConfirmationUI gui_;
     InputTracker input_tracker_;
+    HmacKeySchedule hmac_;
+    /* The confirmation token of the current session, minus the final step. */
+    PartialMac confirmation_token_;
+    /* Clock sample of the message being dispatched. Invalid otherwise. */
+    static PreciseTimeStamp dispatch_time_;
+    /* Time at which the last message was dispatched. */
+    TimeStamp last_activity_;
+    /* True from a successful initHook until the session is torn down. */
+    bool session_active_;
+    /* Set if the UI was blanked but its resources are not released yet. */
+    bool release_pending_;
 };
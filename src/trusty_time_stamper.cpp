@@ -28,7 +28,7 @@
 
 namespace monotonic_time_stamper {
 
-TimeStamp now() {
+PreciseTimeStamp nowPrecise() {
     int rv;
     int64_t secure_time_ns = 0;
     rv = trusty_gettime(0, &secure_time_ns);
@@ -37,7 +37,11 @@ TimeStamp now() {
               secure_time_ns);
         return 0;  // 0 is considered invalid. see TimeStamp::isOk()
     }
-    return static_cast<uint64_t>(secure_time_ns) / 1000000;
+    return static_cast<uint64_t>(secure_time_ns) / 1000;
+}
+
+TimeStamp now() {
+    return nowPrecise().millis();
 }
 
 }  // namespace monotonic_time_stamper
@@ -32,6 +32,28 @@ private:
     bool ok_;
 };
 
+/*
+ * Microsecond resolution time stamp for timing measurements. The protocol
+ * timeouts keep using the millisecond TimeStamp above.
+ */
+class PreciseTimeStamp {
+public:
+    PreciseTimeStamp(uint64_t ts) : timestamp_(ts), ok_(true) {}
+    PreciseTimeStamp() : timestamp_(0), ok_(false) {}
+    bool isOk() const { return ok_; }
+    operator const uint64_t() const { return timestamp_; }
+    TimeStamp millis() const {
+        if (!ok_)
+            return {};
+        return timestamp_ / 1000;
+    }
+
+private:
+    uint64_t timestamp_;
+    bool ok_;
+};
+
 TimeStamp now();
+PreciseTimeStamp nowPrecise();
 
 }  // namespace monotonic_time_stamper
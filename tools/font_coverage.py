@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2021 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Generates the codepoint coverage of TrueType fonts as a C++ header.
+
+For every font, the header defines a sorted array of inclusive codepoint
+ranges, font_coverage::k<Name>, where <Name> is the file name without
+extension and dashes, e.g., kRobotoRegular for Roboto-Regular.ttf. A codepoint
+is covered if the cmap of the font maps it to a glyph other than .notdef.
+
+Only the Python standard library is used so that the build needs nothing
+else.
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+
+class FontError(Exception):
+    pass
+
+
+def find_table(data, tag):
+    num_tables, = struct.unpack_from(">H", data, 4)
+    for i in range(num_tables):
+        entry = 12 + 16 * i
+        if data[entry:entry + 4] == tag:
+            offset, length = struct.unpack_from(">II", data, entry + 8)
+            return offset, length
+    raise FontError("no %s table" % tag.decode())
+
+
+def format4_codepoints(data, offset):
+    seg_count = struct.unpack_from(">H", data, offset + 6)[0] // 2
+    end_codes = offset + 14
+    start_codes = end_codes + 2 * seg_count + 2
+    id_deltas = start_codes + 2 * seg_count
+    id_range_offsets = id_deltas + 2 * seg_count
+    for i in range(seg_count):
+        end, = struct.unpack_from(">H", data, end_codes + 2 * i)
+        start, = struct.unpack_from(">H", data, start_codes + 2 * i)
+        delta, = struct.unpack_from(">h", data, id_deltas + 2 * i)
+        range_offset_pos = id_range_offsets + 2 * i
+        range_offset, = struct.unpack_from(">H", data, range_offset_pos)
+        if start == 0xffff:
+            continue
+        for c in range(start, end + 1):
+            if range_offset == 0:
+                glyph = (c + delta) & 0xffff
+            else:
+                pos = range_offset_pos + range_offset + 2 * (c - start)
+                glyph, = struct.unpack_from(">H", data, pos)
+                if glyph:
+                    glyph = (glyph + delta) & 0xffff
+            if glyph:
+                yield c
+
+
+def format12_codepoints(data, offset):
+    num_groups, = struct.unpack_from(">I", data, offset + 12)
+    for i in range(num_groups):
+        start, end, glyph = struct.unpack_from(
+            ">III", data, offset + 16 + 12 * i)
+        for c in range(start, end + 1):
+            if glyph + (c - start):
+                yield c
+
+
+def codepoints(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    cmap, _ = find_table(data, b"cmap")
+    num_subtables, = struct.unpack_from(">H", data, cmap + 2)
+    subtables = {}
+    for i in range(num_subtables):
+        platform, encoding, offset = struct.unpack_from(
+            ">HHI", data, cmap + 4 + 8 * i)
+        fmt, = struct.unpack_from(">H", data, cmap + offset)
+        subtables[(platform, encoding, fmt)] = cmap + offset
+    # Prefer the full Unicode repertoire over the BMP. Symbol fonts only have
+    # a (3, 0) subtable.
+    for key, parse in (((3, 10, 12), format12_codepoints),
+                       ((0, 4, 12), format12_codepoints),
+                       ((3, 1, 4), format4_codepoints),
+                       ((0, 3, 4), format4_codepoints),
+                       ((3, 0, 4), format4_codepoints)):
+        if key in subtables:
+            return set(parse(data, subtables[key]))
+    raise FontError("no supported Unicode cmap subtable")
+
+
+def ranges(covered):
+    result = []
+    for c in sorted(covered):
+        if result and result[-1][1] == c - 1:
+            result[-1][1] = c
+        else:
+            result.append([c, c])
+    return result
+
+
+def array_name(path):
+    name = os.path.splitext(os.path.basename(path))[0]
+    return "k" + "".join(part for part in name.replace("_", "-").split("-"))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--output", required=True)
+    parser.add_argument("fonts", nargs="+")
+    args = parser.parse_args()
+
+    lines = [
+        "/* Generated by tools/font_coverage.py. Do not edit. */",
+        "",
+        "#pragma once",
+        "",
+        "#include <stdint.h>",
+        "",
+        "namespace font_coverage {",
+        "",
+        "/* An inclusive range of codepoints. */",
+        "struct Range {",
+        "    uint32_t first;",
+        "    uint32_t last;",
+        "};",
+        "",
+    ]
+    for path in args.fonts:
+        try:
+            covered = ranges(codepoints(path))
+        except (FontError, struct.error) as e:
+            sys.exit("%s: %s" % (path, e))
+        lines.append("/* %s */" % os.path.basename(path))
+        lines.append("constexpr Range %s[] = {" % array_name(path))
+        for first, last in covered:
+            lines.append("        {0x%04x, 0x%04x}," % (first, last))
+        lines.append("};")
+        lines.append("")
+    lines.append("}  // namespace font_coverage")
+
+    with open(args.output, "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,642 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Load generator for the ConfirmationUI TA. Dumps the requests recorded by a
+ * TA built with CONFIRMATIONUI_RECORDER and replays them. Also runs the render
+ * sweep of TAs built with CONFIRMATIONUI_RENDER_SWEEP, reads the memory
+ * statistics of TAs built with CONFIRMATIONUI_MEMORY_STATS, and runs the
+ * self-test of TAs built with CONFIRMATIONUI_SELF_TEST. See README.md.
+ *
+ *   confirmationui_replay dump <file>
+ *   confirmationui_replay run [--rate N] [--concurrency C] [--iterations K]
+ *                             [--realtime] <file>...
+ *   confirmationui_replay sweep
+ *   confirmationui_replay memory
+ *   confirmationui_replay selftest
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <BufferAllocator/BufferAllocator.h>
+#include <android-base/file.h>
+#include <android-base/unique_fd.h>
+#include <secure_input/secure_input_proto.h>
+#include <trusty/tipc.h>
+
+#include "ipc.h"
+#include "recorder_proto.h"
+#include "telemetry_proto.h"
+
+using android::base::unique_fd;
+using std::chrono::steady_clock;
+
+namespace {
+
+constexpr const char kTrustyDevice[] = "/dev/trusty-ipc-dev0";
+
+struct Record {
+    confirmationui_record hdr;
+    std::vector<uint8_t> payload;
+};
+
+/* The INIT and MSG records of one recorded channel, in arrival order. */
+struct Session {
+    /* Channels initialized before the recording started use the maximum. */
+    uint32_t shm_len = CONFIRMATIONUI_MAX_MSG_SIZE;
+    std::vector<Record> msgs;
+};
+
+/* A connection to the TA with an initialized shared memory buffer. */
+class Channel {
+public:
+    ~Channel() {
+        if (shm_ != MAP_FAILED) {
+            munmap(shm_, shm_len_);
+        }
+    }
+
+    bool init(uint32_t shm_len) {
+        fd_.reset(tipc_connect(kTrustyDevice, CONFIRMATIONUI_PORT));
+        if (fd_ < 0) {
+            fprintf(stderr, "Failed to connect to %s\n", CONFIRMATIONUI_PORT);
+            return false;
+        }
+        BufferAllocator allocator;
+        shm_fd_.reset(allocator.Alloc("system", shm_len));
+        if (shm_fd_ < 0) {
+            fprintf(stderr, "Failed to allocate %u bytes of shared memory\n",
+                    shm_len);
+            return false;
+        }
+        shm_ = mmap(nullptr, shm_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    shm_fd_, 0);
+        if (shm_ == MAP_FAILED) {
+            return false;
+        }
+        shm_len_ = shm_len;
+
+        struct {
+            confirmationui_hdr hdr;
+            confirmationui_init_req args;
+        } req = {{CONFIRMATIONUI_CMD_INIT}, {shm_len}};
+        iovec iov = {&req, sizeof(req)};
+        trusty_shm shm = {shm_fd_, TRUSTY_SHARE};
+        if (tipc_send(fd_, &iov, 1, &shm, 1) != sizeof(req)) {
+            return false;
+        }
+        confirmationui_hdr resp;
+        return ::read(fd_, &resp, sizeof(resp)) == sizeof(resp) &&
+               resp.cmd == (CONFIRMATIONUI_CMD_INIT | CONFIRMATIONUI_RESP_BIT);
+    }
+
+    /*
+     * Sends a message through the shared memory and waits for the response,
+     * which is copied to resp if given. Returns false if the TA closed the
+     * channel.
+     */
+    bool call(const void* msg, uint32_t len, std::vector<uint8_t>* resp) {
+        if (len > shm_len_) {
+            return false;
+        }
+        memcpy(shm_, msg, len);
+        struct {
+            confirmationui_hdr hdr;
+            confirmationui_msg_args args;
+        } req = {{CONFIRMATIONUI_CMD_MSG}, {len}}, ack;
+        if (TEMP_FAILURE_RETRY(write(fd_, &req, sizeof(req))) != sizeof(req)) {
+            return false;
+        }
+        if (TEMP_FAILURE_RETRY(::read(fd_, &ack, sizeof(ack))) != sizeof(ack) ||
+            ack.hdr.cmd != (CONFIRMATIONUI_CMD_MSG | CONFIRMATIONUI_RESP_BIT) ||
+            ack.args.msg_len > shm_len_) {
+            return false;
+        }
+        if (resp) {
+            auto begin = reinterpret_cast<const uint8_t*>(shm_);
+            resp->assign(begin, begin + ack.args.msg_len);
+        }
+        return true;
+    }
+
+private:
+    unique_fd fd_;
+    unique_fd shm_fd_;
+    void* shm_ = MAP_FAILED;
+    uint32_t shm_len_ = 0;
+};
+
+int dump(const char* path) {
+    Channel channel;
+    if (!channel.init(CONFIRMATIONUI_MAX_MSG_SIZE)) {
+        return EXIT_FAILURE;
+    }
+    std::string recording;
+    uint32_t total = 0;
+    do {
+        uint32_t req[] = {recorder::kRecorderProto,
+                          uint32_t(recorder::RecorderCommand::GetRecording),
+                          uint32_t(recording.size())};
+        std::vector<uint8_t> resp;
+        if (!channel.call(req, sizeof(req), &resp)) {
+            fprintf(stderr, "GetRecording failed\n");
+            return EXIT_FAILURE;
+        }
+        auto [in, rc, size, chunk] = teeui::read(
+                recorder::GetRecordingResponse(),
+                teeui::ReadStream(resp.data(), resp.size()));
+        if (!in || rc != teeui::ResponseCode::OK) {
+            fprintf(stderr, "GetRecording returned %u. Is the TA built with "
+                            "CONFIRMATIONUI_RECORDER?\n",
+                    uint32_t(rc));
+            return EXIT_FAILURE;
+        }
+        if (chunk.size() == 0) {
+            break;
+        }
+        recording.append(chunk.begin(), chunk.end());
+        total = size;
+    } while (recording.size() < total);
+
+    if (!android::base::WriteStringToFile(recording, path)) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return EXIT_FAILURE;
+    }
+    printf("Wrote %zu bytes to %s\n", recording.size(), path);
+    return EXIT_SUCCESS;
+}
+
+int sweep() {
+    Channel channel;
+    if (!channel.init(CONFIRMATIONUI_MAX_MSG_SIZE)) {
+        return EXIT_FAILURE;
+    }
+    uint32_t req[] = {telemetry::kTelemetryProto,
+                      uint32_t(telemetry::TelemetryCommand::RunRenderSweep)};
+    std::vector<uint8_t> resp;
+    if (!channel.call(req, sizeof(req), &resp)) {
+        fprintf(stderr, "RunRenderSweep failed\n");
+        return EXIT_FAILURE;
+    }
+    auto [in, rc, report] =
+            teeui::read(telemetry::RunRenderSweepResponse(),
+                        teeui::ReadStream(resp.data(), resp.size()));
+    confirmationui_sweep hdr;
+    if (!in || rc != teeui::ResponseCode::OK || report.size() < sizeof(hdr)) {
+        fprintf(stderr, "RunRenderSweep returned %u. Is the TA built with "
+                        "CONFIRMATIONUI_RENDER_SWEEP?\n",
+                uint32_t(rc));
+        return EXIT_FAILURE;
+    }
+    memcpy(&hdr, report.data(), sizeof(hdr));
+    size_t entries_size = hdr.entry_count * sizeof(confirmationui_sweep_entry);
+    if (hdr.version != CONFIRMATIONUI_SWEEP_VERSION ||
+        report.size() < sizeof(hdr) + entries_size) {
+        fprintf(stderr, "Unsupported sweep report\n");
+        return EXIT_FAILURE;
+    }
+    printf("%u configurations, slowest first:\n", hdr.total);
+    printf("%-16s %4s %4s %6s %7s %11s %10s %10s %10s %10s %6s %8s\n",
+           "lang", "inv", "mag", "prompt", "display", "size", "render us",
+           "direct us", "tiled us", "heap peak", "status", "checksum");
+    for (uint32_t i = 0; i < hdr.entry_count; ++i) {
+        confirmationui_sweep_entry e;
+        memcpy(&e, report.data() + sizeof(hdr) + i * sizeof(e), sizeof(e));
+        printf("%-16.16s %4u %4u %6u %7u %5ux%-5u %10u %10u %10u %10u %6u "
+               "%08x\n",
+               e.lang_id, e.inverted, e.magnified, e.prompt, e.display,
+               e.width, e.height, e.render_us, e.direct_us, e.tiled_us,
+               e.heap_peak, e.status, e.checksum);
+    }
+    return EXIT_SUCCESS;
+}
+
+int selfTest() {
+    Channel channel;
+    if (!channel.init(CONFIRMATIONUI_MAX_MSG_SIZE)) {
+        return EXIT_FAILURE;
+    }
+    uint32_t req[] = {telemetry::kTelemetryProto,
+                      uint32_t(telemetry::TelemetryCommand::RunSelfTest)};
+    std::vector<uint8_t> resp;
+    if (!channel.call(req, sizeof(req), &resp)) {
+        fprintf(stderr, "RunSelfTest failed\n");
+        return EXIT_FAILURE;
+    }
+    auto [in, rc, report] =
+            teeui::read(telemetry::RunSelfTestResponse(),
+                        teeui::ReadStream(resp.data(), resp.size()));
+    confirmationui_self_test result;
+    if (!in || report.size() < sizeof(result)) {
+        fprintf(stderr, "RunSelfTest returned %u. Is the TA built with "
+                        "CONFIRMATIONUI_SELF_TEST?\n",
+                uint32_t(rc));
+        return EXIT_FAILURE;
+    }
+    memcpy(&result, report.data(), sizeof(result));
+    if (result.version != CONFIRMATIONUI_SELF_TEST_VERSION ||
+        result.step_count != CONFIRMATIONUI_SELF_TEST_STEP_COUNT) {
+        fprintf(stderr, "Unsupported self-test report\n");
+        return EXIT_FAILURE;
+    }
+    static const char* const names[] = {
+            "full render", "enable",    "fb fill",      "fb flip",
+            "hmac",        "handshake", "token finish", "cold handshake",
+    };
+    printf("%u displays, %llu framebuffer bytes\n", result.display_count,
+           static_cast<unsigned long long>(result.fb_bytes));
+    printf("%-14s %6s %10s %10s %10s %6s\n", "step", "runs", "min us",
+           "avg us", "max us", "status");
+    for (uint32_t i = 0; i < result.step_count; ++i) {
+        auto& t = result.steps[i];
+        printf("%-14s %6u %10u %10llu %10u %6u\n", names[i], t.count,
+               t.min_us,
+               static_cast<unsigned long long>(t.count ? t.total_us / t.count
+                                                       : 0),
+               t.max_us, t.status);
+    }
+    auto& fill = result.steps[CONFIRMATIONUI_SELF_TEST_FB_FILL];
+    if (fill.total_us) {
+        printf("framebuffer write speed: %.1f MB/s\n",
+               double(result.fb_bytes) * fill.count / fill.total_us);
+    }
+    return result.status ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+void printUsage(const char* name, const confirmationui_memory_usage& u) {
+    printf("%-24s %8u %10u %10u %12u %10u\n", name, u.count, u.heap_peak,
+           u.allocs_max, u.alloc_bytes_max, u.stack_peak);
+}
+
+int memoryStats() {
+    Channel channel;
+    if (!channel.init(CONFIRMATIONUI_MAX_MSG_SIZE)) {
+        return EXIT_FAILURE;
+    }
+    uint32_t req[] = {telemetry::kTelemetryProto,
+                      uint32_t(telemetry::TelemetryCommand::GetMemoryStats)};
+    std::vector<uint8_t> resp;
+    if (!channel.call(req, sizeof(req), &resp)) {
+        fprintf(stderr, "GetMemoryStats failed\n");
+        return EXIT_FAILURE;
+    }
+    auto [in, rc, report] =
+            teeui::read(telemetry::GetMemoryStatsResponse(),
+                        teeui::ReadStream(resp.data(), resp.size()));
+    confirmationui_memory stats;
+    if (!in || rc != teeui::ResponseCode::OK || report.size() < sizeof(stats)) {
+        fprintf(stderr, "GetMemoryStats returned %u. Is the TA built with "
+                        "CONFIRMATIONUI_MEMORY_STATS?\n",
+                uint32_t(rc));
+        return EXIT_FAILURE;
+    }
+    memcpy(&stats, report.data(), sizeof(stats));
+    if (stats.version != CONFIRMATIONUI_MEMORY_VERSION ||
+        stats.phase_count != CONFIRMATIONUI_PHASE_COUNT ||
+        stats.command_count > CONFIRMATIONUI_MEMORY_COMMANDS) {
+        fprintf(stderr, "Unsupported memory statistics\n");
+        return EXIT_FAILURE;
+    }
+    printf("heap: %u bytes live, %u bytes peak, %llu allocations, %llu bytes\n",
+           stats.heap_live, stats.heap_peak,
+           static_cast<unsigned long long>(stats.allocs),
+           static_cast<unsigned long long>(stats.alloc_bytes));
+    printf("stack: %u of %u bytes peak\n", stats.stack_peak,
+           stats.stack_bytes);
+    printf("%-24s %8s %10s %10s %12s %10s\n", "scope", "count", "heap peak",
+           "allocs", "alloc bytes", "stack");
+    for (uint32_t i = 0; i < stats.phase_count; ++i) {
+        char name[24];
+        snprintf(name, sizeof(name), "phase %u", i);
+        printUsage(name, stats.phases[i]);
+    }
+    for (uint32_t i = 0; i < stats.command_count; ++i) {
+        auto& command = stats.commands[i];
+        char name[24];
+        snprintf(name, sizeof(name), "proto %u cmd %u", command.proto,
+                 command.cmd);
+        printUsage(name, command.usage);
+    }
+    return EXIT_SUCCESS;
+}
+
+/* Splits a recording into sessions. Channels without messages are dropped. */
+bool parse(const char* path, std::vector<Session>* sessions) {
+    std::string data;
+    if (!android::base::ReadFileToString(path, &data)) {
+        fprintf(stderr, "Failed to read %s\n", path);
+        return false;
+    }
+    confirmationui_recording_hdr hdr;
+    if (data.size() < sizeof(hdr)) {
+        fprintf(stderr, "%s: Not a recording\n", path);
+        return false;
+    }
+    memcpy(&hdr, data.data(), sizeof(hdr));
+    if (hdr.version != CONFIRMATIONUI_RECORDING_VERSION) {
+        fprintf(stderr, "%s: Unsupported version %u\n", path, hdr.version);
+        return false;
+    }
+    if (hdr.truncated) {
+        fprintf(stderr, "%s: Recording is truncated\n", path);
+    }
+
+    std::map<uint32_t, Session> open;
+    size_t pos = sizeof(hdr);
+    while (pos + sizeof(confirmationui_record) <= data.size()) {
+        Record record;
+        memcpy(&record.hdr, data.data() + pos, sizeof(record.hdr));
+        pos += sizeof(record.hdr);
+        if (record.hdr.len > data.size() - pos) {
+            fprintf(stderr, "%s: Record exceeds the recording\n", path);
+            return false;
+        }
+        auto payload = reinterpret_cast<const uint8_t*>(data.data() + pos);
+        record.payload.assign(payload, payload + record.hdr.len);
+        pos += record.hdr.len;
+
+        switch (record.hdr.cmd) {
+        case CONFIRMATIONUI_CMD_INIT:
+            if (record.payload.size() != sizeof(uint32_t)) {
+                return false;
+            }
+            memcpy(&open[record.hdr.channel].shm_len, record.payload.data(),
+                   sizeof(uint32_t));
+            break;
+        case CONFIRMATIONUI_CMD_MSG:
+            open[record.hdr.channel].msgs.push_back(std::move(record));
+            break;
+        case CONFIRMATIONUI_RECORD_CLOSE: {
+            auto session = open.find(record.hdr.channel);
+            if (session != open.end()) {
+                if (!session->second.msgs.empty()) {
+                    sessions->push_back(std::move(session->second));
+                }
+                open.erase(session);
+            }
+            break;
+        }
+        default:
+            fprintf(stderr, "%s: Unknown record type %u\n", path,
+                    record.hdr.cmd);
+            return false;
+        }
+    }
+    /* Channels that were still open when the recording stopped. */
+    for (auto& [channel, session] : open) {
+        if (!session.msgs.empty()) {
+            sessions->push_back(std::move(session));
+        }
+    }
+    return true;
+}
+
+/* Protocol and command id, i.e., the first two words of a message. */
+using CommandKey = std::pair<uint32_t, uint32_t>;
+
+CommandKey commandOf(const Record& msg) {
+    uint32_t words[2] = {};
+    memcpy(words, msg.payload.data(),
+           std::min(sizeof(words), msg.payload.size()));
+    return {words[0], words[1]};
+}
+
+/*
+ * Secure input messages are bound to the nonces of the recorded session, so
+ * the TA rejects them on replay and aborts the prompt. They are skipped.
+ */
+bool isReplayable(const CommandKey& key) {
+    return key.first != secure_input::kSecureInputProto;
+}
+
+/* Outcome of the replayed messages of one protocol and command. */
+struct CommandResults {
+    /* Latencies of the messages the TA answered with ResponseCode::OK. */
+    std::vector<uint64_t> latencies_us;
+    uint32_t failed = 0;
+    uint32_t skipped = 0;
+};
+
+struct Results {
+    std::mutex mutex;
+    std::map<CommandKey, CommandResults> commands;
+    /* Sessions in which the TA answered every replayed message with OK. */
+    uint32_t completed = 0;
+    /* Sessions in which the TA answered at least one message with an error. */
+    uint32_t rejected = 0;
+    /* Sessions that could not be replayed because the channel failed. */
+    uint32_t failed = 0;
+};
+
+enum class Outcome { Completed, Rejected, Failed };
+
+/* The ResponseCode a response starts with. */
+teeui::ResponseCode responseCodeOf(const std::vector<uint8_t>& resp) {
+    auto [in, rc] = teeui::read(teeui::Message<teeui::ResponseCode>(),
+                                teeui::ReadStream(resp.data(), resp.size()));
+    return in ? rc : teeui::ResponseCode::SystemError;
+}
+
+Outcome replay(const Session& session, bool realtime, Results* results) {
+    Channel channel;
+    if (!channel.init(session.shm_len)) {
+        return Outcome::Failed;
+    }
+    auto start = steady_clock::now();
+    uint32_t first_ms = session.msgs.front().hdr.time_ms;
+    struct Sample {
+        CommandKey key;
+        bool replayed;
+        bool ok;
+        uint64_t us;
+    };
+    std::vector<Sample> samples;
+    std::vector<uint8_t> resp;
+    bool all_ok = true;
+    for (auto& msg : session.msgs) {
+        auto key = commandOf(msg);
+        if (!isReplayable(key)) {
+            samples.push_back({key, false, false, 0});
+            continue;
+        }
+        if (realtime) {
+            auto offset = msg.hdr.time_ms - first_ms;
+            std::this_thread::sleep_until(start +
+                                          std::chrono::milliseconds(offset));
+        }
+        auto begin = steady_clock::now();
+        if (!channel.call(msg.payload.data(), msg.payload.size(), &resp)) {
+            return Outcome::Failed;
+        }
+        auto elapsed = steady_clock::now() - begin;
+        bool ok = responseCodeOf(resp) == teeui::ResponseCode::OK;
+        all_ok = all_ok && ok;
+        samples.push_back(
+                {key, true, ok,
+                 uint64_t(std::chrono::duration_cast<
+                                  std::chrono::microseconds>(elapsed)
+                                  .count())});
+    }
+    std::lock_guard<std::mutex> lock(results->mutex);
+    for (auto& sample : samples) {
+        auto& command = results->commands[sample.key];
+        if (!sample.replayed) {
+            ++command.skipped;
+        } else if (!sample.ok) {
+            ++command.failed;
+        } else {
+            command.latencies_us.push_back(sample.us);
+        }
+    }
+    return all_ok ? Outcome::Completed : Outcome::Rejected;
+}
+
+uint64_t percentile(const std::vector<uint64_t>& sorted, uint32_t p) {
+    return sorted[(sorted.size() - 1) * p / 100];
+}
+
+void report(Results* results, double seconds) {
+    printf("sessions: %u completed, %u rejected, %u failed in %.2f s "
+           "(%.2f completed sessions/s)\n",
+           results->completed, results->rejected, results->failed, seconds,
+           results->completed / seconds);
+    printf("%8s %8s %8s %8s %8s %10s %10s %10s\n", "proto", "cmd", "ok",
+           "failed", "skipped", "p50 us", "p90 us", "p99 us");
+    for (auto& [key, command] : results->commands) {
+        auto& samples = command.latencies_us;
+        std::sort(samples.begin(), samples.end());
+        printf("%8u %8u %8zu %8u %8u", key.first, key.second, samples.size(),
+               command.failed, command.skipped);
+        if (samples.empty()) {
+            printf(" %10s %10s %10s\n", "-", "-", "-");
+            continue;
+        }
+        printf(" %10llu %10llu %10llu\n",
+               static_cast<unsigned long long>(percentile(samples, 50)),
+               static_cast<unsigned long long>(percentile(samples, 90)),
+               static_cast<unsigned long long>(percentile(samples, 99)));
+    }
+}
+
+int run(int argc, char** argv) {
+    double rate = 0;
+    uint32_t concurrency = 1;
+    uint32_t iterations = 1;
+    bool realtime = false;
+    std::vector<Session> recorded;
+    for (int i = 0; i < argc; ++i) {
+        if (!strcmp(argv[i], "--rate") && i + 1 < argc) {
+            rate = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--concurrency") && i + 1 < argc) {
+            concurrency = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--iterations") && i + 1 < argc) {
+            iterations = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--realtime")) {
+            realtime = true;
+        } else if (!parse(argv[i], &recorded)) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (recorded.empty()) {
+        fprintf(stderr, "No sessions to replay\n");
+        return EXIT_FAILURE;
+    }
+
+    uint32_t count = recorded.size() * iterations;
+    std::atomic<uint32_t> next(0);
+    Results results;
+    auto start = steady_clock::now();
+    auto worker = [&] {
+        for (uint32_t i = next++; i < count; i = next++) {
+            if (rate > 0) {
+                auto offset = std::chrono::microseconds(
+                        static_cast<uint64_t>(i * 1e6 / rate));
+                std::this_thread::sleep_until(start + offset);
+            }
+            auto outcome =
+                    replay(recorded[i % recorded.size()], realtime, &results);
+            std::lock_guard<std::mutex> lock(results.mutex);
+            switch (outcome) {
+            case Outcome::Completed:
+                ++results.completed;
+                break;
+            case Outcome::Rejected:
+                ++results.rejected;
+                break;
+            case Outcome::Failed:
+                ++results.failed;
+                break;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < concurrency; ++i) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> elapsed = steady_clock::now() - start;
+    report(&results, elapsed.count());
+    return results.failed || results.rejected ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+void usage(const char* name) {
+    fprintf(stderr,
+            "usage: %s dump <file>\n"
+            "       %s run [--rate N] [--concurrency C] [--iterations K] "
+            "[--realtime] <file>...\n"
+            "       %s sweep\n"
+            "       %s memory\n"
+            "       %s selftest\n",
+            name, name, name, name, name);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc == 3 && !strcmp(argv[1], "dump")) {
+        return dump(argv[2]);
+    }
+    if (argc == 2 && !strcmp(argv[1], "sweep")) {
+        return sweep();
+    }
+    if (argc == 2 && !strcmp(argv[1], "memory")) {
+        return memoryStats();
+    }
+    if (argc == 2 && !strcmp(argv[1], "selftest")) {
+        return selfTest();
+    }
+    if (argc >= 3 && !strcmp(argv[1], "run")) {
+        return run(argc - 2, argv + 2);
+    }
+    usage(argv[0]);
+    return EXIT_FAILURE;
+}